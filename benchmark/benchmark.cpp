@@ -1,6 +1,8 @@
 #include <benchmark/benchmark.h>
 #include <sys/mman.h>
 
+#include <cstring>
+
 #include "arrow_mmap/arrow_manager.hpp"
 
 const size_t BATCH_SIZE = 5000;
@@ -56,7 +58,158 @@ static void BM_ReaderWillNeedPopulate(benchmark::State& state) {
   }
 }
 
+static void BM_ReaderPrefetch(benchmark::State& state) {
+  auto array_length = 100;
+  auto capacity = BATCH_SIZE / array_length;
+  auto manager = arrow_mmap::ArrowManager::create("benchmark_reader_prefetch", 1, array_length, capacity, SCHEMA,
+                                                  {.madvise = MADV_RANDOM, .fill_with = std::byte(0xff)});
+  nanoarrow::UniqueArrayStream stream;
+  auto reader = manager.reader({.prefetch = {.ahead = 4, .behind = 1}});
+  for (auto _ : state) {
+    for (size_t i = 0; i < capacity; i++) {
+      reader->read(stream, i);
+    }
+  }
+}
+
+struct Quote {
+  int64_t ts;
+  double price;
+  int32_t qty;
+  int32_t side;
+};
+
+const auto QUOTE_SCHEMA = arrow::schema({arrow::field("ts", arrow::int64()), arrow::field("price", arrow::float64()),
+                                         arrow::field("qty", arrow::int32()), arrow::field("side", arrow::int32())});
+const size_t QUOTE_ROWS = 10000;
+
+static void BM_WriterRowsBuilder(benchmark::State& state) {
+  auto manager = arrow_mmap::ArrowManager::create("benchmark_writer_rows_builder", 1, QUOTE_ROWS, 1, QUOTE_SCHEMA);
+  auto writer = manager.writer(0);
+  std::vector<Quote> quotes(QUOTE_ROWS, Quote{1, 2.0, 3, 4});
+  for (auto _ : state) {
+    arrow::Int64Builder ts_builder;
+    arrow::DoubleBuilder price_builder;
+    arrow::Int32Builder qty_builder;
+    arrow::Int32Builder side_builder;
+    for (const auto& quote : quotes) {
+      ts_builder.Append(quote.ts).ok();
+      price_builder.Append(quote.price).ok();
+      qty_builder.Append(quote.qty).ok();
+      side_builder.Append(quote.side).ok();
+    }
+    auto batch = arrow::RecordBatch::Make(
+        QUOTE_SCHEMA, QUOTE_ROWS,
+        {ts_builder.Finish().ValueOrDie(), price_builder.Finish().ValueOrDie(), qty_builder.Finish().ValueOrDie(),
+         side_builder.Finish().ValueOrDie()});
+    writer->write(batch, 0);
+  }
+}
+
+static void BM_WriterRowsTranspose(benchmark::State& state) {
+  auto manager = arrow_mmap::ArrowManager::create("benchmark_writer_rows_transpose", 1, QUOTE_ROWS, 1, QUOTE_SCHEMA);
+  auto writer = manager.writer(0);
+  std::vector<Quote> quotes(QUOTE_ROWS, Quote{1, 2.0, 3, 4});
+  auto layout = arrow_mmap::RowLayout::of<Quote>(QUOTE_SCHEMA, {{"ts", offsetof(Quote, ts), sizeof(int64_t)},
+                                                                {"price", offsetof(Quote, price), sizeof(double)},
+                                                                {"qty", offsetof(Quote, qty), sizeof(int32_t)},
+                                                                {"side", offsetof(Quote, side), sizeof(int32_t)}});
+  for (auto _ : state) {
+    writer->write(reinterpret_cast<const std::byte*>(quotes.data()), quotes.size(), layout, 0);
+  }
+}
+
+// range(0) selects the copy: 0 is a plain memcpy per column, 1 streams every slice, 2 streams on 4 threads
+static void BM_WriterCopy(benchmark::State& state) {
+  auto columns = state.range(1);
+  auto rows = state.range(2);
+  std::vector<std::shared_ptr<arrow::Field>> fields;
+  for (int64_t i = 0; i < columns; ++i) {
+    fields.push_back(arrow::field(std::to_string(i), arrow::int64()));
+  }
+  auto schema = arrow::schema(fields);
+  auto values = arrow::AllocateBuffer(rows * sizeof(int64_t)).ValueOrDie();
+  std::memset(values->mutable_data(), 1, values->size());
+  auto array = arrow::MakeArray(arrow::ArrayData::Make(arrow::int64(), rows, {nullptr, std::move(values)}));
+  auto batch = arrow::RecordBatch::Make(schema, rows, std::vector<std::shared_ptr<arrow::Array>>(columns, array));
+
+  arrow_mmap::CopyOptions copy;
+  copy.stream_threshold = state.range(0) == 0 ? SIZE_MAX : 0;
+  copy.threads = state.range(0) == 2 ? 4 : 1;
+  auto manager = arrow_mmap::ArrowManager::create("benchmark_writer_copy", 1, rows, 1, schema,
+                                                  {.writer_flags = MAP_POPULATE, .fill_with = std::byte(0)});
+  auto writer = manager.writer(0, {.copy = copy});
+  for (auto _ : state) {
+    writer->write(batch, 0);
+  }
+  state.SetBytesProcessed(state.iterations() * columns * rows * sizeof(int64_t));
+}
+
+// the fixed cost of a write and of polling an unwritten batch, compare builds with and without ARROW_MMAP_METRICS
+static void BM_WriterSmall(benchmark::State& state) {
+  auto manager = arrow_mmap::ArrowManager::create("benchmark_writer_small", 1, 64, 1, QUOTE_SCHEMA);
+  auto writer = manager.writer(0);
+  std::vector<Quote> quotes(64, Quote{1, 2.0, 3, 4});
+  auto layout = arrow_mmap::RowLayout::of<Quote>(QUOTE_SCHEMA, {{"ts", offsetof(Quote, ts), sizeof(int64_t)},
+                                                                {"price", offsetof(Quote, price), sizeof(double)},
+                                                                {"qty", offsetof(Quote, qty), sizeof(int32_t)},
+                                                                {"side", offsetof(Quote, side), sizeof(int32_t)}});
+  for (auto _ : state) {
+    writer->write(reinterpret_cast<const std::byte*>(quotes.data()), quotes.size(), layout, 0);
+  }
+  state.SetLabel(arrow_mmap::metrics::ENABLED ? "metrics" : "no metrics");
+}
+
+static void BM_ReaderPoll(benchmark::State& state) {
+  auto manager = arrow_mmap::ArrowManager::create("benchmark_reader_poll", 1, 64, 1, QUOTE_SCHEMA);
+  nanoarrow::UniqueArrayStream stream;
+  auto reader = manager.reader();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(reader->read(stream, 0));
+  }
+  state.SetLabel(arrow_mmap::metrics::ENABLED ? "metrics" : "no metrics");
+}
+
+// 16 int64 columns of 64 batches of 64Ki rows, 512MiB, far more than any last-level cache
+const auto AGGREGATE_SCHEMA = arrow::schema([]() {
+  std::vector<std::shared_ptr<arrow::Field>> fields;
+  for (int i = 0; i < 16; ++i) {
+    fields.push_back(arrow::field(std::to_string(i), arrow::int64()));
+  }
+  return fields;
+}());
+
+// range(0) is the number of threads, range(1) is the layout
+static void BM_Aggregate(benchmark::State& state) {
+  size_t array_length = 1 << 16;
+  size_t capacity = 64;
+  auto layout = static_cast<arrow_mmap::ArrowLayout>(state.range(1));
+  auto manager = arrow_mmap::ArrowManager::create(
+      "benchmark_aggregate", 1, array_length, capacity, AGGREGATE_SCHEMA,
+      {.madvise = MADV_WILLNEED, .fill_with = std::byte(0xff)}, {}, layout);
+  std::vector<std::string> columns;
+  for (const auto& field : AGGREGATE_SCHEMA->fields()) {
+    columns.push_back(field->name());
+  }
+  auto aggregator = manager.aggregator(state.range(0));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(aggregator->aggregate(columns, 0, capacity));
+  }
+  state.SetBytesProcessed(state.iterations() * columns.size() * capacity * array_length * sizeof(int64_t));
+}
+
 BENCHMARK(BM_ReaderNormal)->Iterations(100);
 BENCHMARK(BM_ReaderWillNeed)->Iterations(100);
 BENCHMARK(BM_ReaderWillNeedPopulate)->Iterations(100);
+BENCHMARK(BM_ReaderPrefetch)->Iterations(100);
+BENCHMARK(BM_WriterRowsBuilder);
+BENCHMARK(BM_WriterRowsTranspose);
+BENCHMARK(BM_WriterCopy)
+    ->ArgsProduct({{0, 1, 2}, {16}, {1 << 12, 1 << 16, 1 << 20}})
+    ->ArgsProduct({{0, 1, 2}, {256}, {1 << 8, 1 << 12, 1 << 16}})
+    ->ArgsProduct({{0, 1, 2}, {4096}, {1 << 6, 1 << 10}})
+    ->UseRealTime();
+BENCHMARK(BM_WriterSmall);
+BENCHMARK(BM_ReaderPoll);
+BENCHMARK(BM_Aggregate)->ArgsProduct({{1, 2, 4, 8, 16}, {0, 1}})->UseRealTime();
 BENCHMARK_MAIN();
@@ -0,0 +1,232 @@
+#include "arrow_mmap/arrow_aggregator.hpp"
+
+#include <libassert/assert.hpp>
+
+#include "arrow_mmap/bitflag.hpp"
+
+namespace arrow_mmap {
+
+struct alignas(64) Partial {
+  size_t count = 0;
+  double sum = 0;
+  double min = std::numeric_limits<double>::infinity();
+  double max = -std::numeric_limits<double>::infinity();
+};
+
+/**
+ * Reduce `length` values into `partial`.
+ *
+ * The loop keeps LANES independent accumulators, which breaks the dependency chain of a single accumulator and lets
+ * the compiler turn the inner loop into vector adds and min/max instructions. Integers of up to 32 bits are summed in
+ * 64 bits and only converted to double once per call, which can't overflow for a task of TASK_BYTES. 64-bit values
+ * are summed in double, a nanosecond timestamp alone is about 2^60, so integer lanes would wrap after a few values.
+ */
+template <typename T, typename Acc>
+static void reduce(const T* values, const size_t length, const bool minmax, Partial& partial) {
+  constexpr size_t LANES = 16;
+  constexpr T LOWEST = std::numeric_limits<T>::has_infinity ? -std::numeric_limits<T>::infinity()
+                                                            : std::numeric_limits<T>::lowest();
+  constexpr T HIGHEST =
+      std::numeric_limits<T>::has_infinity ? std::numeric_limits<T>::infinity() : std::numeric_limits<T>::max();
+
+  Acc sums[LANES] = {};
+  T mins[LANES];
+  T maxs[LANES];
+  std::fill(mins, mins + LANES, HIGHEST);
+  std::fill(maxs, maxs + LANES, LOWEST);
+
+  size_t i = 0;
+  if (minmax) {
+    for (; i + LANES <= length; i += LANES) {
+      for (size_t j = 0; j < LANES; j++) {
+        auto value = values[i + j];
+        sums[j] += value;
+        mins[j] = value < mins[j] ? value : mins[j];
+        maxs[j] = value > maxs[j] ? value : maxs[j];
+      }
+    }
+  } else {
+    for (; i + LANES <= length; i += LANES) {
+      for (size_t j = 0; j < LANES; j++) {
+        sums[j] += values[i + j];
+      }
+    }
+  }
+  for (size_t j = 0; i < length; i++, j++) {
+    auto value = values[i];
+    sums[j] += value;
+    mins[j] = value < mins[j] ? value : mins[j];
+    maxs[j] = value > maxs[j] ? value : maxs[j];
+  }
+
+  Acc sum = 0;
+  for (size_t j = 0; j < LANES; j++) {
+    sum += sums[j];
+  }
+  partial.count += length;
+  partial.sum += static_cast<double>(sum);
+  if (minmax) {
+    partial.min = std::min(partial.min, static_cast<double>(*std::min_element(mins, mins + LANES)));
+    partial.max = std::max(partial.max, static_cast<double>(*std::max_element(maxs, maxs + LANES)));
+  }
+}
+
+// the bytes of one column a task reduces at least, so scheduling stays negligible next to the memory traffic
+static const size_t TASK_BYTES = 1 << 20;
+
+static bool aggregatable(const arrow::Type::type type) {
+  switch (type) {
+    case arrow::Type::INT8:
+    case arrow::Type::UINT8:
+    case arrow::Type::INT16:
+    case arrow::Type::UINT16:
+    case arrow::Type::INT32:
+    case arrow::Type::DATE32:
+    case arrow::Type::TIME32:
+    case arrow::Type::UINT32:
+    case arrow::Type::INT64:
+    case arrow::Type::DATE64:
+    case arrow::Type::TIMESTAMP:
+    case arrow::Type::TIME64:
+    case arrow::Type::DURATION:
+    case arrow::Type::UINT64:
+    case arrow::Type::FLOAT:
+    case arrow::Type::DOUBLE:
+      return true;
+    default:
+      return false;
+  }
+}
+
+static void reduce(const arrow::Type::type type, const std::byte* addr, const size_t length, const bool minmax,
+                   Partial& partial) {
+  switch (type) {
+    case arrow::Type::INT8:
+      return reduce<int8_t, int64_t>(reinterpret_cast<const int8_t*>(addr), length, minmax, partial);
+    case arrow::Type::UINT8:
+      return reduce<uint8_t, uint64_t>(reinterpret_cast<const uint8_t*>(addr), length, minmax, partial);
+    case arrow::Type::INT16:
+      return reduce<int16_t, int64_t>(reinterpret_cast<const int16_t*>(addr), length, minmax, partial);
+    case arrow::Type::UINT16:
+      return reduce<uint16_t, uint64_t>(reinterpret_cast<const uint16_t*>(addr), length, minmax, partial);
+    case arrow::Type::INT32:
+    case arrow::Type::DATE32:
+    case arrow::Type::TIME32:
+      return reduce<int32_t, int64_t>(reinterpret_cast<const int32_t*>(addr), length, minmax, partial);
+    case arrow::Type::UINT32:
+      return reduce<uint32_t, uint64_t>(reinterpret_cast<const uint32_t*>(addr), length, minmax, partial);
+    case arrow::Type::INT64:
+    case arrow::Type::DATE64:
+    case arrow::Type::TIMESTAMP:
+    case arrow::Type::TIME64:
+    case arrow::Type::DURATION:
+      return reduce<int64_t, double>(reinterpret_cast<const int64_t*>(addr), length, minmax, partial);
+    case arrow::Type::UINT64:
+      return reduce<uint64_t, double>(reinterpret_cast<const uint64_t*>(addr), length, minmax, partial);
+    case arrow::Type::FLOAT:
+      return reduce<float, double>(reinterpret_cast<const float*>(addr), length, minmax, partial);
+    case arrow::Type::DOUBLE:
+      return reduce<double, double>(reinterpret_cast<const double*>(addr), length, minmax, partial);
+    default:
+      PANIC("unsupported aggregate type");
+  }
+}
+
+ArrowAggregator::ArrowAggregator(const ArrowMeta meta, const IMmapReader* data_reader,
+                                 const IMmapReader* bitflag_reader, const size_t threads)
+    : meta_(meta),
+      data_reader_(data_reader),
+      bitflag_reader_(bitflag_reader),
+      col_sizes_(meta.col_sizes()),
+      col_offsets_(meta.col_offsets()),
+      col_strides_(meta.col_strides()),
+      pool_(threads) {}
+
+std::vector<AggregateResult> ArrowAggregator::aggregate(const std::vector<std::string>& columns, const size_t begin,
+                                                        const size_t end, const uint32_t ops) {
+  ASSERT(begin <= end, "invalid batch range, begin: {}, end: {}", begin, end);
+  ASSERT(end <= meta_.capacity, "index out of range, end: {}, capacity: {}", end, meta_.capacity);
+
+  std::vector<size_t> col_ids;
+  std::vector<arrow::Type::type> col_types;
+  for (const auto& column : columns) {
+    auto col_id = meta_.schema->GetFieldIndex(column);
+    ASSERT(col_id != -1, "column not found, column: {}", column);
+    auto type = meta_.schema->field(col_id)->type();
+    // checked here rather than in the workers, a failure inside the pool would take down the whole process
+    ASSERT(aggregatable(type->id()), "unsupported aggregate type, column: {}, type: {}", column, type->ToString());
+    col_ids.push_back(col_id);
+    col_types.push_back(type->id());
+  }
+
+  // only aggregate batches which are fully written by every writer
+  std::vector<size_t> batches;
+  auto bitflag_addr = bitflag_reader_->mmap_addr();
+  for (size_t index = begin; index < end; index++) {
+    if (bitflag::written(bitflag_addr + index * meta_.writer_count, meta_.writer_count)) batches.push_back(index);
+  }
+
+  // a task reduces a run of consecutive batches of one column, about TASK_BYTES in total
+  struct Task {
+    size_t i;
+    // the range of `batches`
+    size_t first;
+    size_t last;
+  };
+  std::vector<Task> tasks;
+  for (size_t i = 0; i < col_ids.size(); i++) {
+    auto batch_bytes = col_sizes_[col_ids[i]] * meta_.array_length;
+    auto max_batches = std::max<size_t>(1, TASK_BYTES / std::max<size_t>(1, batch_bytes));
+    for (size_t first = 0; first < batches.size();) {
+      auto last = first + 1;
+      while (last < batches.size() && last - first < max_batches && batches[last] == batches[last - 1] + 1) last++;
+      tasks.push_back({i, first, last});
+      first = last;
+    }
+  }
+
+  // a column of consecutive batches is one contiguous buffer in a column-major store
+  const bool contiguous = meta_.layout == ArrowLayout::COLUMN_MAJOR;
+  const bool minmax = ops & (AGGREGATE_MIN | AGGREGATE_MAX);
+  std::vector<std::vector<Partial>> partials(pool_.size(), std::vector<Partial>(col_ids.size()));
+  pool_.parallel_for(tasks.size(), [&](size_t task, size_t worker) {
+    const auto& [i, first, last] = tasks[task];
+    auto col_id = col_ids[i];
+    auto batch_bytes = col_sizes_[col_id] * meta_.array_length;
+    if (contiguous) {
+      auto offset = col_offsets_[col_id] + batches[first] * col_strides_[col_id];
+      auto col_addr = data_reader_->range(offset, batch_bytes * (last - first));
+      reduce(col_types[i], col_addr, meta_.array_length * (last - first), minmax, partials[worker][i]);
+      return;
+    }
+    for (auto k = first; k < last; k++) {
+      auto col_addr = data_reader_->range(col_offsets_[col_id] + batches[k] * col_strides_[col_id], batch_bytes);
+      reduce(col_types[i], col_addr, meta_.array_length, minmax, partials[worker][i]);
+    }
+  });
+
+  std::vector<AggregateResult> results(col_ids.size());
+  for (size_t i = 0; i < col_ids.size(); i++) {
+    Partial total;
+    for (const auto& worker_partials : partials) {
+      const auto& partial = worker_partials[i];
+      total.count += partial.count;
+      total.sum += partial.sum;
+      total.min = std::min(total.min, partial.min);
+      total.max = std::max(total.max, partial.max);
+    }
+
+    auto& result = results[i];
+    result.count = total.count;
+    result.batches = batches.size();
+    if (ops & AGGREGATE_SUM) result.sum = total.sum;
+    if (total.count > 0) {
+      if (ops & AGGREGATE_MIN) result.min = total.min;
+      if (ops & AGGREGATE_MAX) result.max = total.max;
+      if (ops & AGGREGATE_MEAN) result.mean = total.sum / total.count;
+    }
+  }
+  return results;
+}
+
+}  // namespace arrow_mmap
@@ -0,0 +1,70 @@
+#ifndef ARROW_MMAP_ARROW_AGGREGATOR_HPP
+#define ARROW_MMAP_ARROW_AGGREGATOR_HPP
+#pragma once
+
+#include <arrow/api.h>
+
+#include "arrow_mmap/arrow_meta.hpp"
+#include "arrow_mmap/interface.hpp"
+#include "arrow_mmap/thread_pool.hpp"
+
+namespace arrow_mmap {
+
+enum AggregateOp : uint32_t {
+  AGGREGATE_SUM = 1 << 0,
+  AGGREGATE_MIN = 1 << 1,
+  AGGREGATE_MAX = 1 << 2,
+  AGGREGATE_MEAN = 1 << 3,
+  AGGREGATE_ALL = AGGREGATE_SUM | AGGREGATE_MIN | AGGREGATE_MAX | AGGREGATE_MEAN,
+};
+
+struct AggregateResult {
+  // the number of values aggregated
+  size_t count = 0;
+  // the number of fully written batches in the range
+  size_t batches = 0;
+  // ops which are not requested are NaN
+  double sum = std::numeric_limits<double>::quiet_NaN();
+  double min = std::numeric_limits<double>::quiet_NaN();
+  double max = std::numeric_limits<double>::quiet_NaN();
+  double mean = std::numeric_limits<double>::quiet_NaN();
+};
+
+class ArrowAggregator {
+ public:
+  /**
+   * @param threads The number of aggregation threads, 0 means `std::thread::hardware_concurrency()`.
+   */
+  ArrowAggregator(const ArrowMeta meta, const IMmapReader* data_reader, const IMmapReader* bitflag_reader,
+                  const size_t threads = 0);
+
+  /**
+   * @brief Aggregate columns over the batches in [begin, end).
+   *
+   * Batches which are not fully written yet are skipped. Every task reduces about 1MiB of one column, a run of
+   * consecutive batches, in place without building any arrow array. In a column-major store such a run is a single
+   * contiguous buffer.
+   *
+   * @param columns The names of numeric columns to aggregate.
+   * @param begin The first batch index.
+   * @param end The batch index after the last one.
+   * @param ops The bitwise or of `AggregateOp`.
+   * @return One result per column, in the same order as `columns`.
+   */
+  std::vector<AggregateResult> aggregate(const std::vector<std::string>& columns, const size_t begin, const size_t end,
+                                         const uint32_t ops = AGGREGATE_ALL);
+
+ private:
+  const ArrowMeta meta_;
+  const IMmapReader* data_reader_;
+  const IMmapReader* bitflag_reader_;
+  const std::vector<size_t> col_sizes_;
+  const std::vector<size_t> col_offsets_;
+  const std::vector<size_t> col_strides_;
+
+  ThreadPool pool_;
+};
+
+}  // namespace arrow_mmap
+
+#endif  // ARROW_MMAP_ARROW_AGGREGATOR_HPP
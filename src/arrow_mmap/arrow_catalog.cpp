@@ -0,0 +1,297 @@
+#include "arrow_mmap/arrow_catalog.hpp"
+
+#include <filesystem>
+#include <libassert/assert.hpp>
+#include <mutex>
+#include <sstream>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace arrow_mmap {
+
+// defined in arrow_manager.cpp, the catalog arenas use the same file names as a single store
+const std::string get_data_file(const std::string& location);
+const std::string get_bitflag_file(const std::string& location);
+
+const std::string get_catalog_file(const std::string& location) {
+  return std::filesystem::path(std::filesystem::absolute(location)) / "catalog.bin";
+}
+
+// keep every table on its own pages, and bitflags of different tables on different cache lines
+static const size_t DATA_ALIGNMENT = 4096;
+static const size_t BITFLAG_ALIGNMENT = 64;
+
+static inline size_t align_up(size_t value, size_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+struct CatalogEntry {
+  uint64_t data_offset;
+  uint64_t data_length;
+  uint64_t bitflag_offset;
+  uint64_t bitflag_length;
+  ArrowMeta meta;
+};
+
+// holds a `flock` on the index file for the current scope
+class IndexLock {
+ public:
+  IndexLock(int fd, int operation) : fd_(fd) {
+    ASSERT(-1 != flock(fd_, operation), std::format("failed to lock catalog index, error: {}", strerror(errno)));
+  }
+  ~IndexLock() { flock(fd_, LOCK_UN); }
+
+ private:
+  int fd_;
+};
+
+class ArrowCatalog::Impl {
+ public:
+  Impl(const std::string& location, int index_fd, MmapManager&& data_manager, MmapManager&& bitflag_manager,
+       const size_t data_capacity, const size_t bitflag_capacity)
+      : location_(location),
+        index_fd_(index_fd),
+        data_manager_(std::move(data_manager)),
+        bitflag_manager_(std::move(bitflag_manager)),
+        data_capacity_(data_capacity),
+        bitflag_capacity_(bitflag_capacity) {}
+
+  ~Impl() { close(index_fd_); }
+
+  std::shared_ptr<ArrowManager> create_table(const std::string& name, const size_t writer_count,
+                                             const size_t array_length, const size_t capacity,
+                                             const std::shared_ptr<arrow::Schema> schema, const ArrowLayout layout) {
+    ASSERT(!name.empty(), "table name must not be empty");
+    auto meta = ArrowMeta{
+        .writer_count = writer_count,
+        .array_length = array_length,
+        .capacity = capacity,
+        .schema = schema,
+        .layout = layout,
+    };
+    meta.validate();
+    ASSERT(!meta.has_dictionary(), "catalog tables don't support dictionary columns");
+
+    std::lock_guard lock(mutex_);
+    {
+      // other processes may create tables concurrently, so allocate from the latest index
+      IndexLock index_lock(index_fd_, LOCK_EX);
+      refresh();
+      ASSERT(!entries_.contains(name), "table already exists, name: {}", name);
+
+      auto data_length = capacity * meta.batch_size();
+      auto bitflag_length = capacity * writer_count;
+      auto data_offset = align_up(data_end_, DATA_ALIGNMENT);
+      auto bitflag_offset = align_up(bitflag_end_, BITFLAG_ALIGNMENT);
+      ASSERT(data_offset + data_length <= data_capacity_, "data arena is full, table: {}, required: {}, capacity: {}",
+             name, data_offset + data_length, data_capacity_);
+      ASSERT(bitflag_offset + bitflag_length <= bitflag_capacity_,
+             "bitflag arena is full, table: {}, required: {}, capacity: {}", name, bitflag_offset + bitflag_length,
+             bitflag_capacity_);
+
+      // a record is appended with a single write, so readers never see a partial record
+      std::ostringstream meta_stream;
+      meta.serialize(meta_stream);
+      auto meta_bytes = meta_stream.str();
+      std::string record;
+      auto append = [&record](uint64_t value) { record.append(reinterpret_cast<const char*>(&value), sizeof(value)); };
+      append(0);  // placeholder of the record length
+      append(name.size());
+      record.append(name);
+      append(data_offset);
+      append(data_length);
+      append(bitflag_offset);
+      append(bitflag_length);
+      append(meta_bytes.size());
+      record.append(meta_bytes);
+      uint64_t record_length = record.size() - sizeof(uint64_t);
+      std::memcpy(record.data(), &record_length, sizeof(uint64_t));
+
+      ASSERT(static_cast<ssize_t>(record.size()) == write(index_fd_, record.data(), record.size()),
+             std::format("failed to write catalog index, error: {}", strerror(errno)));
+      refresh();
+    }
+    return open(name);
+  }
+
+  std::shared_ptr<ArrowManager> table(const std::string& name) {
+    std::lock_guard lock(mutex_);
+    if (!entries_.contains(name)) {
+      IndexLock index_lock(index_fd_, LOCK_SH);
+      refresh();
+    }
+    ASSERT(entries_.contains(name), "table not found, name: {}", name);
+    return open(name);
+  }
+
+  std::vector<std::string> tables() {
+    std::lock_guard lock(mutex_);
+    {
+      IndexLock index_lock(index_fd_, LOCK_SH);
+      refresh();
+    }
+    std::vector<std::string> names;
+    for (const auto& [name, _] : entries_) {
+      names.push_back(name);
+    }
+    std::sort(names.begin(), names.end());
+    return names;
+  }
+
+  void release(const std::string& name) {
+    std::lock_guard lock(mutex_);
+    tables_.erase(name);
+  }
+
+ private:
+  // parse the records appended to the index since the last refresh
+  void refresh() {
+    struct stat st;
+    ASSERT(-1 != fstat(index_fd_, &st), std::format("failed to stat catalog index, error: {}", strerror(errno)));
+    if (static_cast<size_t>(st.st_size) <= index_size_) return;
+
+    std::string buffer(st.st_size - index_size_, '\0');
+    ASSERT(static_cast<ssize_t>(buffer.size()) == pread(index_fd_, buffer.data(), buffer.size(), index_size_),
+           std::format("failed to read catalog index, error: {}", strerror(errno)));
+
+    size_t pos = 0;
+    auto read = [&buffer, &pos]() {
+      uint64_t value;
+      std::memcpy(&value, buffer.data() + pos, sizeof(value));
+      pos += sizeof(value);
+      return value;
+    };
+    while (pos + sizeof(uint64_t) <= buffer.size()) {
+      auto record_begin = pos;
+      auto record_length = read();
+      if (pos + record_length > buffer.size()) {
+        pos = record_begin;
+        break;
+      }
+      auto name_length = read();
+      auto name = buffer.substr(pos, name_length);
+      pos += name_length;
+      CatalogEntry entry;
+      entry.data_offset = read();
+      entry.data_length = read();
+      entry.bitflag_offset = read();
+      entry.bitflag_length = read();
+      auto meta_length = read();
+      std::istringstream meta_stream(buffer.substr(pos, meta_length));
+      pos += meta_length;
+      entry.meta = ArrowMeta::deserialize(meta_stream);
+
+      data_end_ = std::max<size_t>(data_end_, entry.data_offset + entry.data_length);
+      bitflag_end_ = std::max<size_t>(bitflag_end_, entry.bitflag_offset + entry.bitflag_length);
+      entries_.emplace(std::move(name), std::move(entry));
+    }
+    index_size_ += pos;
+  }
+
+  std::shared_ptr<ArrowManager> open(const std::string& name) {
+    auto table = tables_.find(name);
+    if (table != tables_.end()) return table->second;
+
+    const auto& entry = entries_.at(name);
+    auto manager = std::shared_ptr<ArrowManager>(
+        new ArrowManager(data_manager_.slice(entry.data_offset, entry.data_length),
+                         bitflag_manager_.slice(entry.bitflag_offset, entry.bitflag_length), entry.meta));
+    tables_.emplace(name, manager);
+    return manager;
+  }
+
+  friend class ArrowCatalog;
+
+  const std::string location_;
+  const int index_fd_;
+  const MmapManager data_manager_;
+  const MmapManager bitflag_manager_;
+  const size_t data_capacity_;
+  const size_t bitflag_capacity_;
+
+  std::mutex mutex_;
+  size_t index_size_ = 0;
+  size_t data_end_ = 0;
+  size_t bitflag_end_ = 0;
+  std::unordered_map<std::string, CatalogEntry> entries_;
+  std::unordered_map<std::string, std::shared_ptr<ArrowManager>> tables_;
+};
+
+ArrowCatalog::ArrowCatalog(const std::string& location, const MmapManagerOptions& options) {
+  ASSERT(options.backend == MmapBackend::FILE, "catalogs only support the file backend");
+  ASSERT(ready(location), "ArrowCatalog is not ready to use");
+
+  auto catalog_file = get_catalog_file(location);
+  int index_fd = ::open(catalog_file.c_str(), O_RDWR | O_APPEND | O_CLOEXEC);
+  ASSERT(index_fd != -1, std::format("failed to open file: {}, error: {}", catalog_file, strerror(errno)));
+
+  auto data_file = get_data_file(location);
+  auto bitflag_file = get_bitflag_file(location);
+  auto data_capacity = std::filesystem::file_size(data_file);
+  auto bitflag_capacity = std::filesystem::file_size(bitflag_file);
+  // only the data arena is windowed, the bitflags are small and accessed all over
+  auto bitflag_options = options;
+  bitflag_options.window = {};
+  impl_ = new Impl(location, index_fd, MmapManager(data_file, options), MmapManager(bitflag_file, bitflag_options),
+                   data_capacity, bitflag_capacity);
+}
+
+ArrowCatalog::~ArrowCatalog() {
+  if (impl_) {
+    delete impl_;
+  }
+}
+
+ArrowCatalog ArrowCatalog::create(const std::string& location, const size_t data_capacity,
+                                  const size_t bitflag_capacity, const MmapManagerCreateOptions& options) {
+  // the index is a file locked with flock, so the arenas live next to it
+  ASSERT(options.backend == MmapBackend::FILE, "catalogs only support the file backend");
+  if (!std::filesystem::exists(location)) {
+    std::filesystem::create_directories(location);
+  }
+
+  // the arenas are left sparse, unwritten bitflags must read as zero
+  auto arena_options = options;
+  arena_options.fill_with = std::byte(0x00);
+  arena_options.sparse = true;
+  auto data_file = get_data_file(location);
+  auto data_manager = MmapManager::create(data_file, data_capacity, arena_options);
+  auto bitflag_file = get_bitflag_file(location);
+  auto bitflag_options = arena_options;
+  bitflag_options.window = {};
+  auto bitflag_manager = MmapManager::create(bitflag_file, bitflag_capacity, bitflag_options);
+
+  // make sure create index is atomic, which means when index file is created, the ArrowCatalog is ready to use
+  auto catalog_file = get_catalog_file(location);
+  auto catalog_tmp_file = catalog_file + ".tmp";
+  int index_fd = ::open(catalog_tmp_file.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC,
+                        S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+  ASSERT(index_fd != -1, std::format("failed to open file: {}, error: {}", catalog_tmp_file, strerror(errno)));
+  std::filesystem::rename(catalog_tmp_file, catalog_file);
+
+  return ArrowCatalog(new Impl(location, index_fd, std::move(data_manager), std::move(bitflag_manager), data_capacity,
+                               bitflag_capacity));
+}
+
+bool ArrowCatalog::ready(const std::string& location) noexcept {
+  return std::filesystem::exists(get_catalog_file(location));
+}
+
+std::shared_ptr<ArrowManager> ArrowCatalog::create_table(const std::string& name, const size_t writer_count,
+                                                         const size_t array_length, const size_t capacity,
+                                                         const std::shared_ptr<arrow::Schema> schema,
+                                                         const ArrowLayout layout) {
+  return impl_->create_table(name, writer_count, array_length, capacity, schema, layout);
+}
+
+std::shared_ptr<ArrowManager> ArrowCatalog::table(const std::string& name) { return impl_->table(name); }
+
+std::vector<std::string> ArrowCatalog::tables() { return impl_->tables(); }
+
+void ArrowCatalog::release(const std::string& name) { impl_->release(name); }
+
+}  // namespace arrow_mmap
@@ -0,0 +1,91 @@
+#ifndef ARROW_MMAP_ARROW_CATALOG_HPP
+#define ARROW_MMAP_ARROW_CATALOG_HPP
+#pragma once
+
+#include <arrow/api.h>
+
+#include "arrow_mmap/arrow_manager.hpp"
+#include "arrow_mmap/manager.hpp"
+
+namespace arrow_mmap {
+
+/**
+ * @brief ArrowCatalog hosts many named tables inside one directory.
+ *
+ * All tables share one `data.mmap` and one `bitflag.mmap` arena, each mapped once per process, and a `catalog.bin`
+ * index which records the arena ranges and the ArrowMeta of every table. Opening a table is a lookup in the index
+ * which slices the shared mappings, it never opens or maps another file.
+ */
+class ArrowCatalog {
+ public:
+  ArrowCatalog(const std::string& location, const MmapManagerOptions& options = {});
+  ~ArrowCatalog();
+
+  // disable copy and assign
+  ArrowCatalog(const ArrowCatalog&) = delete;
+  ArrowCatalog& operator=(const ArrowCatalog&) = delete;
+
+  // support move
+  ArrowCatalog(ArrowCatalog&& other) noexcept : impl_(other.impl_) { other.impl_ = nullptr; }
+
+  /**
+   * @brief Create an empty catalog.
+   *
+   * The arena files are created sparse, so their capacity only reserves address space until tables are written.
+   *
+   * @param location The directory where the catalog files are stored.
+   * @param data_capacity The byte size of the data arena shared by all tables.
+   * @param bitflag_capacity The byte size of the bitflag arena shared by all tables.
+   */
+  static ArrowCatalog create(const std::string& location, const size_t data_capacity, const size_t bitflag_capacity,
+                             const MmapManagerCreateOptions& options = {});
+
+  /**
+   * @brief Check if the ArrowCatalog is ready to use.
+   *
+   * @param location The directory where the catalog files are stored.
+   * @return true if the ArrowCatalog is ready to use, false otherwise.
+   */
+  static bool ready(const std::string& location) noexcept;
+
+  /**
+   * @brief Allocate a new table in the arenas, the parameters are the same as `ArrowManager::create`.
+   *
+   * Creating tables is safe across processes sharing the catalog.
+   *
+   * @return The ArrowManager of the table.
+   */
+  std::shared_ptr<ArrowManager> create_table(const std::string& name, const size_t writer_count,
+                                             const size_t array_length, const size_t capacity,
+                                             const std::shared_ptr<arrow::Schema> schema,
+                                             const ArrowLayout layout = ArrowLayout::BATCH_MAJOR);
+
+  /**
+   * @brief Get the ArrowManager of an existing table, tables created by other processes are picked up as well.
+   */
+  std::shared_ptr<ArrowManager> table(const std::string& name);
+
+  /**
+   * @brief Get the names of all tables.
+   */
+  std::vector<std::string> tables();
+
+  /**
+   * @brief Drop the cached ArrowManager of a table.
+   *
+   * The arenas are unmapped and closed once the catalog and every ArrowManager of its tables are released.
+   */
+  void release(const std::string& name);
+
+ private:
+  class Impl;
+  friend class Impl;
+
+  ArrowCatalog(Impl* impl) : impl_(impl) {}
+
+  Impl* impl_;
+};
+
+}  // namespace arrow_mmap
+
+#endif  // ARROW_MMAP_ARROW_CATALOG_HPP
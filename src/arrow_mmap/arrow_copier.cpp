@@ -0,0 +1,134 @@
+#include "arrow_mmap/arrow_copier.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <immintrin.h>
+#endif
+
+// the AVX2 copy is built for every x86-64 target and picked at runtime, so it doesn't need -mavx2
+#if defined(__SSE2__) && defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define ARROW_MMAP_STREAM_AVX2
+#endif
+
+namespace arrow_mmap {
+
+// the largest piece of a slice handed to one copy thread
+static const size_t CHUNK_SIZE = 1 << 20;
+
+#ifdef __SSE2__
+// memcpy the bytes before the first `width` aligned address of `dst`, returns how many were copied
+static size_t copy_head(std::byte* dst, const std::byte* src, const size_t length, const size_t width) noexcept {
+  auto head = std::min(length, (width - reinterpret_cast<uintptr_t>(dst) % width) % width);
+  std::memcpy(dst, src, head);
+  return head;
+}
+
+static void stream_copy_sse2(std::byte* dst, const std::byte* src, size_t length) noexcept {
+  const size_t width = sizeof(__m128i);
+  auto head = copy_head(dst, src, length, width);
+  dst += head;
+  src += head;
+  length -= head;
+
+  size_t i = 0;
+  for (; i + 4 * width <= length; i += 4 * width) {
+    auto v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    auto v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + width));
+    auto v2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 2 * width));
+    auto v3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 3 * width));
+    _mm_stream_si128(reinterpret_cast<__m128i*>(dst + i), v0);
+    _mm_stream_si128(reinterpret_cast<__m128i*>(dst + i + width), v1);
+    _mm_stream_si128(reinterpret_cast<__m128i*>(dst + i + 2 * width), v2);
+    _mm_stream_si128(reinterpret_cast<__m128i*>(dst + i + 3 * width), v3);
+  }
+  std::memcpy(dst + i, src + i, length - i);
+  _mm_sfence();
+}
+#endif
+
+#ifdef ARROW_MMAP_STREAM_AVX2
+__attribute__((target("avx2"))) static void stream_copy_avx2(std::byte* dst, const std::byte* src,
+                                                             size_t length) noexcept {
+  const size_t width = sizeof(__m256i);
+  auto head = copy_head(dst, src, length, width);
+  dst += head;
+  src += head;
+  length -= head;
+
+  size_t i = 0;
+  for (; i + 4 * width <= length; i += 4 * width) {
+    auto v0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+    auto v1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i + width));
+    auto v2 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i + 2 * width));
+    auto v3 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i + 3 * width));
+    _mm256_stream_si256(reinterpret_cast<__m256i*>(dst + i), v0);
+    _mm256_stream_si256(reinterpret_cast<__m256i*>(dst + i + width), v1);
+    _mm256_stream_si256(reinterpret_cast<__m256i*>(dst + i + 2 * width), v2);
+    _mm256_stream_si256(reinterpret_cast<__m256i*>(dst + i + 3 * width), v3);
+  }
+  std::memcpy(dst + i, src + i, length - i);
+  _mm_sfence();
+}
+
+static const bool HAS_AVX2 = __builtin_cpu_supports("avx2");
+#endif
+
+/**
+ * Copy with non-temporal stores.
+ *
+ * The destination is aligned with a short memcpy, then the body is streamed in 32 (AVX2, when the CPU has it) or 16
+ * (SSE2) byte stores from unaligned loads. Non-temporal stores are weakly ordered, so the copy ends with a store fence.
+ * Other targets fall back to memcpy.
+ */
+static void stream_copy(std::byte* dst, const std::byte* src, const size_t length) noexcept {
+#ifdef ARROW_MMAP_STREAM_AVX2
+  if (HAS_AVX2) return stream_copy_avx2(dst, src, length);
+#endif
+#ifdef __SSE2__
+  stream_copy_sse2(dst, src, length);
+#else
+  std::memcpy(dst, src, length);
+#endif
+}
+
+ArrowCopier::ArrowCopier(const CopyOptions& options)
+    : stream_threshold_(options.stream_threshold),
+      pool_(options.threads > 1 ? std::make_unique<ThreadPool>(options.threads, options.cpus) : nullptr) {}
+
+void ArrowCopier::copy(std::byte* dst, const std::byte* src, const size_t length) const noexcept {
+  if (length >= stream_threshold_) {
+    stream_copy(dst, src, length);
+  } else {
+    std::memcpy(dst, src, length);
+  }
+}
+
+void ArrowCopier::copy(const std::vector<CopySlice>& slices) {
+  if (!pool_) {
+    for (const auto& slice : slices) copy(slice.dst, slice.src, slice.length);
+    return;
+  }
+
+  // split large slices, so a few wide columns still spread over every thread
+  chunks_.clear();
+  for (const auto& slice : slices) {
+    for (size_t offset = 0; offset < slice.length; offset += CHUNK_SIZE) {
+      chunks_.push_back({{slice.dst + offset, slice.src + offset, std::min(CHUNK_SIZE, slice.length - offset)},
+                         slice.length >= stream_threshold_});
+    }
+  }
+  // each thread fences its own non-temporal stores in `stream_copy`
+  pool_->parallel_for(chunks_.size(), [this](size_t task, size_t) {
+    const auto& [chunk, stream] = chunks_[task];
+    if (stream) {
+      stream_copy(chunk.dst, chunk.src, chunk.length);
+    } else {
+      std::memcpy(chunk.dst, chunk.src, chunk.length);
+    }
+  });
+}
+
+}  // namespace arrow_mmap
@@ -0,0 +1,66 @@
+#ifndef ARROW_MMAP_ARROW_COPIER_HPP
+#define ARROW_MMAP_ARROW_COPIER_HPP
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "arrow_mmap/thread_pool.hpp"
+
+namespace arrow_mmap {
+
+struct CopyOptions {
+  // slices of at least this many bytes bypass the cache with non-temporal stores, SIZE_MAX always uses memcpy
+  size_t stream_threshold = 256 << 10;
+  // the number of threads copying one batch including the writer thread, 1 copies on the writer thread only
+  size_t threads = 1;
+  // pin the copy threads round-robin to these cpus, empty leaves them unpinned
+  std::vector<int> cpus = {};
+};
+
+struct CopySlice {
+  std::byte* dst;
+  const std::byte* src;
+  size_t length;
+};
+
+/**
+ * @brief ArrowCopier copies the column slices of a batch into the mapping.
+ *
+ * A freshly written slice is only read again by other processes, so large slices are copied with non-temporal stores
+ * which neither read the destination lines first nor evict the writer's working set. With `threads` > 1 the slices,
+ * split into chunks of at most 1MiB, are spread over a small thread pool, since a single core can't saturate the
+ * memory bandwidth for wide schemas. Every copy is fenced before `copy` returns, so the bitflag store which publishes
+ * the batch is never visible before its data.
+ */
+class ArrowCopier {
+ public:
+  ArrowCopier(const CopyOptions& options = {});
+
+  /**
+   * @brief Copy `length` bytes, with non-temporal stores when `length` is at least the stream threshold.
+   */
+  void copy(std::byte* dst, const std::byte* src, const size_t length) const noexcept;
+
+  /**
+   * @brief Copy every slice, blocks until all of them are done.
+   */
+  void copy(const std::vector<CopySlice>& slices);
+
+ private:
+  struct Chunk {
+    CopySlice slice;
+    // the whole slice is at least the stream threshold
+    bool stream;
+  };
+
+  const size_t stream_threshold_;
+  std::unique_ptr<ThreadPool> pool_;
+  // reused by `copy`, so splitting the slices doesn't allocate per batch
+  std::vector<Chunk> chunks_;
+};
+
+}  // namespace arrow_mmap
+
+#endif  // ARROW_MMAP_ARROW_COPIER_HPP
@@ -0,0 +1,158 @@
+#include "arrow_mmap/arrow_dictionary.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstring>
+#include <libassert/assert.hpp>
+
+namespace arrow_mmap {
+
+static const uint64_t DICTIONARY_MAGIC = 0x5443494444414d4d;  // "MMADDICT"
+
+struct DictionaryHeader {
+  uint64_t magic;
+  uint64_t slot_count;
+  uint64_t value_capacity;
+  uint64_t byte_capacity;
+  // the offsets of values with an id less than `published` are stored, i.e. readers can see them
+  uint64_t published;
+  uint64_t padding[3];
+};
+
+static_assert(sizeof(DictionaryHeader) == 64);
+
+// a slot is 0 when empty, otherwise the high 32 bits of the value hash and id + 1
+static inline uint64_t make_slot(uint64_t hash, uint64_t id) { return (hash & 0xffffffff00000000) | (id + 1); }
+static inline uint32_t slot_id(uint64_t slot) { return static_cast<uint32_t>(slot) - 1; }
+static inline bool slot_matches(uint64_t slot, uint64_t hash) { return (slot >> 32) == (hash >> 32); }
+
+// FNV-1a followed by the murmur3 finalizer, so both the low bits (slot index) and high bits (tag) are well mixed
+static uint64_t hash_value(std::string_view value) {
+  uint64_t hash = 0xcbf29ce484222325;
+  for (auto c : value) {
+    hash = (hash ^ static_cast<uint8_t>(c)) * 0x100000001b3;
+  }
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccd;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+static uint64_t get_slot_count(const DictionaryOptions& options) {
+  // keep the load factor at most 0.5, so probe sequences stay short
+  return std::bit_ceil(std::max<uint64_t>(2 * options.values, 2));
+}
+
+size_t ArrowDictionary::file_length(const DictionaryOptions& options) {
+  return sizeof(DictionaryHeader) + get_slot_count(options) * sizeof(uint64_t) +
+         (options.values + 1) * sizeof(int32_t) + options.values * sizeof(uint32_t) + options.bytes;
+}
+
+void ArrowDictionary::init(const IMmapWriter* writer, const DictionaryOptions& options) {
+  ASSERT(options.values > 0, "dictionary values must be greater than 0");
+  ASSERT(options.values < UINT32_MAX, "dictionary values must be less than 2^32");
+  ASSERT(options.bytes <= INT32_MAX, "dictionary bytes must be less than 2GiB");
+  ASSERT(writer->length() >= file_length(options), "dictionary file is too small");
+
+  auto header = reinterpret_cast<DictionaryHeader*>(writer->mmap_addr());
+  header->slot_count = get_slot_count(options);
+  header->value_capacity = options.values;
+  header->byte_capacity = options.bytes;
+  header->published = 0;
+  std::atomic_ref(header->magic).store(DICTIONARY_MAGIC, std::memory_order_release);
+}
+
+ArrowDictionary::ArrowDictionary(const IMmapWriter* writer) : addr_(writer->mmap_addr()) {
+  auto header = reinterpret_cast<DictionaryHeader*>(addr_);
+  ASSERT(std::atomic_ref(header->magic).load(std::memory_order_acquire) == DICTIONARY_MAGIC,
+         "dictionary file is not initialized");
+  slot_mask_ = header->slot_count - 1;
+  value_capacity_ = header->value_capacity;
+  byte_capacity_ = header->byte_capacity;
+  slots_ = reinterpret_cast<uint64_t*>(addr_ + sizeof(DictionaryHeader));
+  offsets_ = reinterpret_cast<int32_t*>(slots_ + header->slot_count);
+  ends_ = reinterpret_cast<uint32_t*>(offsets_ + value_capacity_ + 1);
+  data_ = reinterpret_cast<char*>(ends_ + value_capacity_);
+}
+
+std::string_view ArrowDictionary::value(uint32_t id) const noexcept {
+  auto begin = std::atomic_ref(offsets_[id]).load(std::memory_order_acquire);
+  auto end = std::atomic_ref(offsets_[id + 1]).load(std::memory_order_acquire);
+  return std::string_view(data_ + begin, end - begin);
+}
+
+uint32_t ArrowDictionary::intern(std::string_view value) {
+  auto hash = hash_value(value);
+  auto index = hash & slot_mask_;
+  while (true) {
+    auto slot = std::atomic_ref(slots_[index]).load(std::memory_order_acquire);
+    if (slot == 0) break;
+    if (slot_matches(slot, hash) && this->value(slot_id(slot)) == value) return slot_id(slot);
+    index = (index + 1) & slot_mask_;
+  }
+
+  // claim the first free id, its value starts where the value of the previous id ends
+  auto id = publish();
+  uint64_t begin;
+  while (true) {
+    ASSERT(id < value_capacity_, "dictionary is full, values: {}", value_capacity_);
+    begin = id == 0 ? 0 : std::atomic_ref(ends_[id - 1]).load(std::memory_order_acquire) - 1;
+    ASSERT(begin + value.size() <= byte_capacity_, "dictionary is full, bytes: {}", byte_capacity_);
+    uint32_t end = 0;
+    if (std::atomic_ref(ends_[id]).compare_exchange_strong(end, static_cast<uint32_t>(begin + value.size() + 1),
+                                                           std::memory_order_acq_rel)) {
+      break;
+    }
+    id++;
+  }
+
+  std::memcpy(data_ + begin, value.data(), value.size());
+  publish();
+
+  // continue probing where the lookup stopped, another writer may have inserted the same value meanwhile
+  while (true) {
+    uint64_t slot = 0;
+    if (std::atomic_ref(slots_[index]).compare_exchange_strong(slot, make_slot(hash, id), std::memory_order_acq_rel)) {
+      return id;
+    }
+    if (slot_matches(slot, hash) && this->value(slot_id(slot)) == value) return slot_id(slot);
+    index = (index + 1) & slot_mask_;
+  }
+}
+
+int64_t ArrowDictionary::find(std::string_view value) const {
+  auto hash = hash_value(value);
+  auto index = hash & slot_mask_;
+  while (true) {
+    auto slot = std::atomic_ref(slots_[index]).load(std::memory_order_acquire);
+    if (slot == 0) return -1;
+    if (slot_matches(slot, hash) && this->value(slot_id(slot)) == value) return slot_id(slot);
+    index = (index + 1) & slot_mask_;
+  }
+}
+
+size_t ArrowDictionary::size() const noexcept { return publish(); }
+
+size_t ArrowDictionary::publish() const noexcept {
+  auto header = reinterpret_cast<DictionaryHeader*>(addr_);
+  std::atomic_ref published(header->published);
+  auto current = published.load(std::memory_order_acquire);
+  // ids are claimed in order, so the claimed ids are always a prefix
+  auto end = current;
+  while (end < value_capacity_) {
+    auto claimed = std::atomic_ref(ends_[end]).load(std::memory_order_acquire);
+    if (claimed == 0) break;
+    // every thread stores the same value, so helping with the offsets of other claims is idempotent
+    std::atomic_ref(offsets_[end + 1]).store(static_cast<int32_t>(claimed - 1), std::memory_order_relaxed);
+    end++;
+  }
+  while (current < end &&
+         !published.compare_exchange_weak(current, end, std::memory_order_release, std::memory_order_acquire)) {
+  }
+  return std::max<size_t>(current, end);
+}
+
+}  // namespace arrow_mmap
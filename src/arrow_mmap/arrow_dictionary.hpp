@@ -0,0 +1,86 @@
+#ifndef ARROW_MMAP_ARROW_DICTIONARY_HPP
+#define ARROW_MMAP_ARROW_DICTIONARY_HPP
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+#include "arrow_mmap/interface.hpp"
+
+namespace arrow_mmap {
+
+struct DictionaryOptions {
+  // the maximum number of distinct values
+  size_t values = 1 << 20;
+  // the maximum number of bytes of all values, must be less than 2GiB because offsets are int32
+  size_t bytes = 64 << 20;
+};
+
+/**
+ * @brief ArrowDictionary is an append-only string dictionary shared by every dictionary column of a store.
+ *
+ * The file holds a header, an open addressing hash table, and the values laid out exactly like the offsets and data
+ * buffers of an arrow string array, so readers use the file as the dictionary of their arrays without copying.
+ *
+ * Writers of any process intern values without locks or waiting on each other. A value claims the next id with one
+ * CAS on its end offset, which also fixes where it starts, since it starts where the previous id ends. Any thread
+ * turns claimed end offsets into arrow offsets, so the offsets stay valid even if a writer stalls or dies right after
+ * its claim. The value bytes are copied next, and the value is inserted into the hash table with a CAS. Two writers
+ * interning the same value concurrently may both append it, but only the one which wins the hash slot is ever
+ * returned, so equal values always map to the same id.
+ *
+ * Readers see every claimed id. A value whose writer is still copying, or died while copying, may hold partial
+ * bytes. No batch can reference it, because ids are only returned after their bytes are copied.
+ */
+class ArrowDictionary {
+ public:
+  ArrowDictionary(const IMmapWriter* writer);
+
+  /**
+   * @brief The file length required by `options`.
+   */
+  static size_t file_length(const DictionaryOptions& options);
+
+  /**
+   * @brief Initialize the header of an empty, zero filled dictionary file.
+   */
+  static void init(const IMmapWriter* writer, const DictionaryOptions& options);
+
+  /**
+   * @brief Get the id of `value`, appending it to the dictionary if it doesn't exist yet.
+   */
+  uint32_t intern(std::string_view value);
+
+  /**
+   * @brief Get the id of `value`, or -1 if it doesn't exist.
+   */
+  int64_t find(std::string_view value) const;
+
+  /**
+   * @brief The number of values which are visible to readers, i.e. the number of claimed ids.
+   */
+  size_t size() const noexcept;
+
+  // offsets and data of the visible values, in the layout of an arrow string array
+  const int32_t* offsets() const noexcept { return offsets_; }
+  const char* data() const noexcept { return data_; }
+
+ private:
+  std::string_view value(uint32_t id) const noexcept;
+  // store the offsets of every claimed id and return the number of claimed ids, never waits for other writers
+  size_t publish() const noexcept;
+
+  std::byte* addr_;
+  uint64_t slot_mask_;
+  uint64_t value_capacity_;
+  uint64_t byte_capacity_;
+  uint64_t* slots_;
+  int32_t* offsets_;
+  // the end offset + 1 of every claimed id, 0 for ids which are not claimed yet
+  uint32_t* ends_;
+  char* data_;
+};
+
+}  // namespace arrow_mmap
+
+#endif  // ARROW_MMAP_ARROW_DICTIONARY_HPP
@@ -0,0 +1,101 @@
+#include "arrow_mmap/arrow_flusher.hpp"
+
+#include <algorithm>
+
+#include <unistd.h>
+
+#include "arrow_mmap/bitflag.hpp"
+
+namespace arrow_mmap {
+
+ArrowFlusher::ArrowFlusher(const size_t id, const ArrowMeta& meta, const IMmapWriter* data_writer,
+                           const IMmapWriter* bitflag_writer, const FlushOptions& options)
+    : id_(id),
+      meta_(meta),
+      data_writer_(data_writer),
+      bitflag_writer_(bitflag_writer),
+      group_batches_(options.policy == FlushPolicy::GROUP ? std::max<size_t>(1, options.group_batches) : 1),
+      group_interval_(options.policy == FlushPolicy::GROUP ? options.group_interval : std::chrono::milliseconds(0)),
+      page_size_(sysconf(_SC_PAGESIZE)),
+      thread_([this]() { loop(); }) {}
+
+ArrowFlusher::~ArrowFlusher() {
+  {
+    std::lock_guard lock(mutex_);
+    stop_ = true;
+  }
+  pending_cv_.notify_one();
+  thread_.join();
+}
+
+void ArrowFlusher::push(const size_t index) {
+  bool notify;
+  {
+    std::lock_guard lock(mutex_);
+    pending_.push_back(index);
+    pushed_++;
+    notify = pending_.size() >= group_batches_;
+  }
+  if (notify) pending_cv_.notify_one();
+}
+
+void ArrowFlusher::flush() {
+  std::unique_lock lock(mutex_);
+  flushing_ = true;
+  pending_cv_.notify_one();
+  published_cv_.wait(lock, [this]() { return published_ >= pushed_; });
+  flushing_ = false;
+}
+
+void ArrowFlusher::loop() {
+  std::vector<size_t> indexes;
+  std::unique_lock lock(mutex_);
+  while (true) {
+    auto ready = [this]() {
+      return stop_ || (!pending_.empty() && (flushing_ || pending_.size() >= group_batches_));
+    };
+    if (group_interval_.count() > 0) {
+      // flush whatever is pending once the interval elapsed
+      pending_cv_.wait_for(lock, group_interval_, ready);
+    } else {
+      pending_cv_.wait(lock, ready);
+    }
+
+    if (pending_.empty()) {
+      if (stop_) return;
+      continue;
+    }
+
+    indexes.swap(pending_);
+    lock.unlock();
+    publish(indexes);
+    lock.lock();
+
+    published_ += indexes.size();
+    indexes.clear();
+    published_cv_.notify_all();
+  }
+}
+
+void ArrowFlusher::publish(std::vector<size_t>& indexes) {
+  // merge adjacent batches, so that a group commit issues one flush per contiguous range
+  std::sort(indexes.begin(), indexes.end());
+  for (size_t i = 0; i < indexes.size();) {
+    size_t j = i + 1;
+    while (j < indexes.size() && indexes[j] <= indexes[j - 1] + 1) j++;
+    // only this writer's slices, the other writers sync their own
+    for (const auto& [offset, length] : meta_.writer_ranges(id_, indexes[i], indexes[j - 1] + 1, page_size_)) {
+      data_writer_->sync(offset, length);
+    }
+    i = j;
+  }
+
+  // data is on disk, now it is safe to mark the batches as written
+  auto bitflag_addr = bitflag_writer_->mmap_addr();
+  for (const auto& index : indexes) {
+    bitflag::publish(bitflag_addr[index * meta_.writer_count + id_]);
+    ARROW_MMAP_PROBE2(publish, id_, index);
+  }
+}
+
+}  // namespace arrow_mmap
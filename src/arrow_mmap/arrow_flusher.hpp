@@ -0,0 +1,83 @@
+#ifndef ARROW_MMAP_ARROW_FLUSHER_HPP
+#define ARROW_MMAP_ARROW_FLUSHER_HPP
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "arrow_mmap/arrow_meta.hpp"
+#include "arrow_mmap/interface.hpp"
+#include "arrow_mmap/metrics.hpp"
+
+namespace arrow_mmap {
+
+enum class FlushPolicy {
+  // never flush, dirty pages are written back whenever the kernel decides
+  NONE,
+  // flush every batch on a background thread
+  ASYNC,
+  // flush on a background thread once `group_batches` batches are pending or every `group_interval`
+  GROUP,
+  // flush every batch before `write` returns
+  SYNC,
+};
+
+struct FlushOptions {
+  FlushPolicy policy = FlushPolicy::NONE;
+  size_t group_batches = 16;
+  std::chrono::milliseconds group_interval{10};
+};
+
+/**
+ * @brief ArrowFlusher publishes the batches of one writer after their data reached the backing store.
+ *
+ * `push` hands a written batch index over to the background thread, which flushes this writer's byte ranges of the
+ * pending batches and only then sets their bitflags. A batch is therefore never marked as written on disk before its
+ * data.
+ */
+class ArrowFlusher {
+ public:
+  ArrowFlusher(const size_t id, const ArrowMeta& meta, const IMmapWriter* data_writer,
+               const IMmapWriter* bitflag_writer, const FlushOptions& options);
+  ~ArrowFlusher();
+
+  // disable copy and assign
+  ArrowFlusher(const ArrowFlusher&) = delete;
+  ArrowFlusher& operator=(const ArrowFlusher&) = delete;
+
+  void push(const size_t index);
+
+  /**
+   * @brief Block until every pushed batch is flushed and published.
+   */
+  void flush();
+
+ private:
+  void loop();
+  void publish(std::vector<size_t>& indexes);
+
+  const size_t id_;
+  const ArrowMeta meta_;
+  const IMmapWriter* data_writer_;
+  const IMmapWriter* bitflag_writer_;
+  const size_t group_batches_;
+  const std::chrono::milliseconds group_interval_;
+  const size_t page_size_;
+
+  std::mutex mutex_;
+  std::condition_variable pending_cv_;
+  std::condition_variable published_cv_;
+  std::vector<size_t> pending_;
+  size_t pushed_ = 0;
+  size_t published_ = 0;
+  bool flushing_ = false;
+  bool stop_ = false;
+  std::thread thread_;
+};
+
+}  // namespace arrow_mmap
+
+#endif  // ARROW_MMAP_ARROW_FLUSHER_HPP
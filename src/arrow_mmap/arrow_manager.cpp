@@ -1,7 +1,12 @@
 #include "arrow_mmap/arrow_manager.hpp"
 
+#include <atomic>
+#include <cstring>
 #include <filesystem>
 #include <libassert/assert.hpp>
+#include <memory>
+#include <optional>
+#include <sstream>
 #include <vector>
 
 namespace arrow_mmap {
@@ -18,53 +23,188 @@ const std::string get_meta_file(const std::string& location) {
   return std::filesystem::path(std::filesystem::absolute(location)) / "meta.bin";
 }
 
+const std::string get_dictionary_file(const std::string& location) {
+  return std::filesystem::path(std::filesystem::absolute(location)) / "dictionary.mmap";
+}
+
+/**
+ * Shm and memfd stores keep their meta in a mapping as well, as the serialized meta preceded by its byte size.
+ *
+ * The size is stored last, so the store is ready to use once the size is not 0.
+ */
+static void write_meta(const MmapManager& manager, const std::string& meta_bytes) {
+  auto addr = manager.writer()->mmap_addr();
+  std::memcpy(addr + sizeof(uint64_t), meta_bytes.data(), meta_bytes.size());
+  std::atomic_ref(*reinterpret_cast<uint64_t*>(addr)).store(meta_bytes.size(), std::memory_order_release);
+}
+
+static ArrowMeta read_meta(const MmapManager& manager) {
+  auto addr = manager.reader()->mmap_addr();
+  auto size =
+      std::atomic_ref(*reinterpret_cast<uint64_t*>(const_cast<std::byte*>(addr))).load(std::memory_order_acquire);
+  ASSERT(size > 0 && sizeof(uint64_t) + size <= manager.reader()->length(), "meta is not written yet");
+  std::istringstream stream(std::string(reinterpret_cast<const char*>(addr) + sizeof(uint64_t), size));
+  return ArrowMeta::deserialize(stream);
+}
+
 class ArrowManager::Impl {
  public:
-  Impl(MmapManager&& data_manager, MmapManager&& bitflag_manager, const ArrowMeta meta)
+  Impl(MmapManager&& data_manager, MmapManager&& bitflag_manager, std::optional<MmapManager>&& dictionary_manager,
+       std::optional<MmapManager>&& meta_manager, const ArrowMeta meta)
       : data_manager_(std::move(data_manager)),
         bitflag_manager_(std::move(bitflag_manager)),
+        dictionary_manager_(std::move(dictionary_manager)),
+        meta_manager_(std::move(meta_manager)),
         meta_(meta),
-        writers_(std::vector<std::shared_ptr<ArrowWriter>>(meta.writer_count)) {}
+        writers_(std::vector<std::shared_ptr<ArrowWriter>>(meta.writer_count)) {
+    ASSERT(meta.has_dictionary() == dictionary_manager_.has_value(), "dictionary file doesn't match the schema");
+  }
 
-  const std::shared_ptr<ArrowWriter> writer(const size_t id) noexcept {
+  const std::shared_ptr<ArrowWriter> writer(const size_t id, const ArrowWriterOptions& options) noexcept {
     ASSERT(id < meta_.writer_count, "id out of range, id: {}, writer_count: {}", id, meta_.writer_count);
     auto writer = writers_[id];
     if (nullptr == writer) {
-      writer = std::make_shared<ArrowWriter>(id, meta_, data_manager_.writer(), bitflag_manager_.writer());
+      writer = share<ArrowWriter>({&data_manager_, &bitflag_manager_}, [&](const auto& slices) {
+        return std::make_unique<ArrowWriter>(id, meta_, slices[0].writer(), slices[1].writer(), dictionary().get(),
+                                             options);
+      });
       writers_[id] = writer;
     }
     return writer;
   }
 
-  const std::shared_ptr<ArrowReader> reader() noexcept {
+  const std::shared_ptr<ArrowReader> reader(const ArrowReaderOptions& options) noexcept {
     if (nullptr == reader_) {
-      reader_ = std::make_shared<ArrowReader>(meta_, data_manager_.reader(), bitflag_manager_.reader());
+      reader_ = share<ArrowReader>({&data_manager_, &bitflag_manager_}, [&](const auto& slices) {
+        return std::make_unique<ArrowReader>(meta_, slices[0].reader(), slices[1].reader(), dictionary().get(),
+                                             options);
+      });
     }
     return reader_;
   }
 
+  const std::shared_ptr<ArrowDictionary> dictionary() noexcept {
+    if (nullptr == dictionary_ && dictionary_manager_) {
+      dictionary_ = share<ArrowDictionary>({&*dictionary_manager_}, [](const auto& slices) {
+        return std::make_unique<ArrowDictionary>(slices[0].writer());
+      });
+    }
+    return dictionary_;
+  }
+
+  const std::shared_ptr<ArrowAggregator> aggregator(const size_t threads) noexcept {
+    if (nullptr == aggregator_) {
+      aggregator_ = share<ArrowAggregator>({&data_manager_, &bitflag_manager_}, [&](const auto& slices) {
+        return std::make_unique<ArrowAggregator>(meta_, slices[0].reader(), slices[1].reader(), threads);
+      });
+    }
+    return aggregator_;
+  }
+
+  const std::shared_ptr<ArrowShipper> shipper(const ReplicationOptions& options) noexcept {
+    ASSERT(!dictionary_manager_, "replication of dictionary columns is not supported");
+    if (nullptr == shipper_) {
+      shipper_ = share<ArrowShipper>({&data_manager_, &bitflag_manager_}, [&](const auto& slices) {
+        return std::make_unique<ArrowShipper>(meta_, slices[0].reader(), slices[1].reader(), options);
+      });
+    }
+    return shipper_;
+  }
+
+  const std::shared_ptr<ArrowFollower> follower(const ReplicationOptions& options) noexcept {
+    ASSERT(!dictionary_manager_, "replication of dictionary columns is not supported");
+    if (nullptr == follower_) {
+      follower_ = share<ArrowFollower>({&data_manager_, &bitflag_manager_}, [&](const auto& slices) {
+        return std::make_unique<ArrowFollower>(meta_, slices[0].writer(), slices[1].writer(), options);
+      });
+    }
+    return follower_;
+  }
+
+  ArrowMetrics metrics() const noexcept {
+    ArrowMetrics metrics;
+    metrics.writers.resize(writers_.size());
+    for (size_t id = 0; id < writers_.size(); id++) {
+      if (writers_[id]) metrics.writers[id] = writers_[id]->metrics();
+    }
+    if (reader_) metrics.reader = reader_->metrics();
+    return metrics;
+  }
+
  private:
   friend class ArrowManager;
 
+  // a component together with everything it points into
+  template <typename T>
+  struct Shared {
+    std::vector<MmapManager> slices;
+    std::shared_ptr<ArrowDictionary> dictionary;
+    // declared last, so it is destroyed before the mappings it uses
+    std::unique_ptr<T> component;
+  };
+
+  /**
+   * Create a component with `make` from slices covering `managers`.
+   *
+   * Components only hold raw pointers into the mappings, so the returned pointer owns the slices and the dictionary as
+   * well, and the component stays valid after the ArrowManager is released, like the tables of an ArrowCatalog.
+   */
+  template <typename T, typename F>
+  std::shared_ptr<T> share(const std::vector<const MmapManager*>& managers, F&& make) {
+    auto shared = std::make_shared<Shared<T>>();
+    for (auto manager : managers) shared->slices.push_back(manager->slice(0, manager->length()));
+    shared->component = make(shared->slices);
+    // `make` may create the dictionary the component uses
+    shared->dictionary = dictionary_;
+    return std::shared_ptr<T>(shared, shared->component.get());
+  }
+
   const MmapManager data_manager_;
   const MmapManager bitflag_manager_;
+  const std::optional<MmapManager> dictionary_manager_;
+  // the meta mapping of shm and memfd stores
+  const std::optional<MmapManager> meta_manager_;
   const ArrowMeta meta_;
+  std::shared_ptr<ArrowDictionary> dictionary_;
   std::vector<std::shared_ptr<ArrowWriter>> writers_;
   std::shared_ptr<ArrowReader> reader_;
+  std::shared_ptr<ArrowAggregator> aggregator_;
+  std::shared_ptr<ArrowShipper> shipper_;
+  std::shared_ptr<ArrowFollower> follower_;
 };
 
 ArrowManager::ArrowManager(const std::string& location, const MmapManagerOptions& options) {
-  ASSERT(ready(location), "ArrowManager is not ready to use");
+  ASSERT(options.backend != MmapBackend::MEMFD, "a memfd store can't be opened by location, receive it instead");
+  ASSERT(ready(location, options.backend), "ArrowManager is not ready to use");
+
+  // only the data file is windowed, the bitflags, the dictionary and the meta are small and accessed all over
+  auto unwindowed_options = options;
+  unwindowed_options.window = {};
 
   auto meta_file = get_meta_file(location);
-  auto meta = ArrowMeta::deserialize(meta_file);
+  std::optional<MmapManager> meta_manager;
+  ArrowMeta meta;
+  if (options.backend == MmapBackend::FILE) {
+    meta = ArrowMeta::deserialize(meta_file);
+  } else {
+    meta_manager.emplace(meta_file, unwindowed_options);
+    meta = read_meta(*meta_manager);
+  }
   auto data_file = get_data_file(location);
   auto bitflag_file = get_bitflag_file(location);
   auto data_manager = MmapManager(data_file, options);
-  auto bitflag_manager = MmapManager(bitflag_file, options);
-  impl_ = new Impl(std::move(data_manager), std::move(bitflag_manager), meta);
+  auto bitflag_manager = MmapManager(bitflag_file, unwindowed_options);
+  std::optional<MmapManager> dictionary_manager;
+  if (meta.has_dictionary()) {
+    dictionary_manager.emplace(get_dictionary_file(location), unwindowed_options);
+  }
+  impl_ = new Impl(std::move(data_manager), std::move(bitflag_manager), std::move(dictionary_manager),
+                   std::move(meta_manager), meta);
 }
 
+ArrowManager::ArrowManager(MmapManager&& data_manager, MmapManager&& bitflag_manager, const ArrowMeta& meta)
+    : impl_(new Impl(std::move(data_manager), std::move(bitflag_manager), std::nullopt, std::nullopt, meta)) {}
+
 ArrowManager::~ArrowManager() {
   if (impl_) {
     delete impl_;
@@ -73,54 +213,134 @@ ArrowManager::~ArrowManager() {
 
 ArrowManager ArrowManager::create(const std::string& location, const size_t writer_count, const size_t array_length,
                                   const size_t capacity, const std::shared_ptr<arrow::Schema> schema,
-                                  const MmapManagerCreateOptions& options) {
-  if (!std::filesystem::exists(location)) {
+                                  const MmapManagerCreateOptions& options, const DictionaryOptions& dictionary,
+                                  const ArrowLayout layout) {
+  if (options.backend == MmapBackend::FILE && !std::filesystem::exists(location)) {
     std::filesystem::create_directories(location);
   }
 
-  ASSERT(writer_count > 0, "writer_count must be greater than 0");
-  ASSERT(array_length > 0, "array_length must be greater than 0");
-  ASSERT(capacity > 0, "capacity must be greater than 0");
-  ASSERT(!schema->fields().empty(), "schema must have at least one field");
-  ASSERT(writer_count <= array_length, "writer_count must be less than or equal to array_length");
+  auto meta = ArrowMeta{
+      .writer_count = writer_count,
+      .array_length = array_length,
+      .capacity = capacity,
+      .schema = schema,
+      .layout = layout,
+  };
+  meta.validate();
 
   // init data manager
   auto data_file = get_data_file(location);
-  auto data_length = capacity * array_length *
-                     std::accumulate(schema->fields().begin(), schema->fields().end(), 0,
-                                     [](size_t acc, const auto& field) { return acc + field->type()->byte_width(); });
+  auto data_length = capacity * meta.batch_size();
   auto data_manager = MmapManager::create(data_file, data_length, options);
 
   // init bitflag manager
   auto bitflag_file = get_bitflag_file(location);
   auto bitflag_length = capacity * writer_count;
-  auto bitflag_manager = MmapManager::create(bitflag_file, bitflag_length, options);
+  // only the data file is windowed, the bitflags and the dictionary are small and accessed all over
+  auto unwindowed_options = options;
+  unwindowed_options.window = {};
+  auto bitflag_manager = MmapManager::create(bitflag_file, bitflag_length, unwindowed_options);
 
-  // init meta
-  auto meta = ArrowMeta{
-      .writer_count = writer_count,
-      .array_length = array_length,
-      .capacity = capacity,
-      .schema = schema,
-  };
+  // init dictionary manager, the dictionary must start zero filled whatever `options.fill_with` is
+  std::optional<MmapManager> dictionary_manager;
+  if (meta.has_dictionary()) {
+    auto dictionary_options = unwindowed_options;
+    dictionary_options.fill_with = std::byte(0x00);
+    dictionary_manager.emplace(MmapManager::create(get_dictionary_file(location),
+                                                   ArrowDictionary::file_length(dictionary), dictionary_options));
+    ArrowDictionary::init(dictionary_manager->writer(), dictionary);
+  }
 
   // make sure create meta is atomic, which means when meta file is created, the ArrowManager is ready to use
   auto meta_file = get_meta_file(location);
-  auto meta_tmp_file = meta_file + ".tmp";
-  meta.serialize(meta_tmp_file);
-  std::filesystem::rename(meta_tmp_file, meta_file);
+  std::optional<MmapManager> meta_manager;
+  if (options.backend == MmapBackend::FILE) {
+    auto meta_tmp_file = meta_file + ".tmp";
+    meta.serialize(meta_tmp_file);
+    std::filesystem::rename(meta_tmp_file, meta_file);
+  } else {
+    std::ostringstream meta_stream;
+    meta.serialize(meta_stream);
+    auto meta_bytes = meta_stream.str();
+    auto meta_options = unwindowed_options;
+    meta_options.fill_with = std::byte(0x00);
+    meta_manager.emplace(MmapManager::create(meta_file, sizeof(uint64_t) + meta_bytes.size(), meta_options));
+    write_meta(*meta_manager, meta_bytes);
+  }
 
-  auto impl = new Impl(std::move(data_manager), std::move(bitflag_manager), meta);
+  auto impl = new Impl(std::move(data_manager), std::move(bitflag_manager), std::move(dictionary_manager),
+                       std::move(meta_manager), meta);
   return ArrowManager(impl);
 }
 
-inline bool ArrowManager::ready(const std::string& location) noexcept {
-  return std::filesystem::exists(get_meta_file(location));
+bool ArrowManager::ready(const std::string& location, const MmapBackend backend) noexcept {
+  switch (backend) {
+    case MmapBackend::FILE:
+      return std::filesystem::exists(get_meta_file(location));
+    case MmapBackend::SHM: {
+      if (!MmapManager::exists(get_meta_file(location), backend)) return false;
+      // the shm object exists as soon as it is created, it is ready once the meta size is written
+      MmapManager meta_manager(get_meta_file(location), {.backend = backend});
+      auto addr = const_cast<std::byte*>(meta_manager.reader()->mmap_addr());
+      return std::atomic_ref(*reinterpret_cast<uint64_t*>(addr)).load(std::memory_order_acquire) > 0;
+    }
+    case MmapBackend::MEMFD:
+      return false;
+  }
+  return false;
+}
+
+void ArrowManager::remove(const std::string& location, const MmapBackend backend) {
+  // remove the meta first, so the store is never ready with some of its files missing
+  MmapManager::remove(get_meta_file(location), backend);
+  MmapManager::remove(get_data_file(location), backend);
+  MmapManager::remove(get_bitflag_file(location), backend);
+  MmapManager::remove(get_dictionary_file(location), backend);
+}
+
+void ArrowManager::send(int socket) const {
+  ASSERT(impl_->meta_manager_.has_value(), "only shm and memfd stores can be sent, open file stores by location");
+  // the data is sent on its own, so the receiver can window it
+  std::vector<const MmapManager*> managers{&*impl_->meta_manager_, &impl_->bitflag_manager_};
+  if (impl_->dictionary_manager_) managers.push_back(&*impl_->dictionary_manager_);
+  MmapManager::send(socket, managers);
+  MmapManager::send(socket, {&impl_->data_manager_});
+}
+
+ArrowManager ArrowManager::receive(int socket, const MmapManagerOptions& options) {
+  auto unwindowed_options = options;
+  unwindowed_options.window = {};
+  auto managers = MmapManager::receive(socket, unwindowed_options);
+  auto data_managers = MmapManager::receive(socket, options);
+  ASSERT(managers.size() >= 2 && data_managers.size() == 1, "received managers are not an ArrowManager");
+
+  auto meta = read_meta(managers[0]);
+  std::optional<MmapManager> dictionary_manager;
+  if (managers.size() > 2) dictionary_manager.emplace(std::move(managers[2]));
+  std::optional<MmapManager> meta_manager(std::move(managers[0]));
+  return ArrowManager(new Impl(std::move(data_managers[0]), std::move(managers[1]), std::move(dictionary_manager),
+                               std::move(meta_manager), meta));
 }
 
 const ArrowMeta& ArrowManager::meta() const noexcept { return impl_->meta_; }
 
-const std::shared_ptr<ArrowWriter> ArrowManager::writer(const size_t id) noexcept { return impl_->writer(id); }
-const std::shared_ptr<ArrowReader> ArrowManager::reader() noexcept { return impl_->reader(); }
+const std::shared_ptr<ArrowWriter> ArrowManager::writer(const size_t id, const ArrowWriterOptions& options) noexcept {
+  return impl_->writer(id, options);
+}
+const std::shared_ptr<ArrowReader> ArrowManager::reader(const ArrowReaderOptions& options) noexcept {
+  return impl_->reader(options);
+}
+const std::shared_ptr<ArrowDictionary> ArrowManager::dictionary() noexcept { return impl_->dictionary(); }
+const std::shared_ptr<ArrowAggregator> ArrowManager::aggregator(const size_t threads) noexcept {
+  return impl_->aggregator(threads);
+}
+const std::shared_ptr<ArrowShipper> ArrowManager::shipper(const ReplicationOptions& options) noexcept {
+  return impl_->shipper(options);
+}
+const std::shared_ptr<ArrowFollower> ArrowManager::follower(const ReplicationOptions& options) noexcept {
+  return impl_->follower(options);
+}
+
+ArrowMetrics ArrowManager::metrics() const noexcept { return impl_->metrics(); }
 
 }  // namespace arrow_mmap
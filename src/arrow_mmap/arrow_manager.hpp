@@ -4,13 +4,21 @@
 
 #include <arrow/api.h>
 
+#include "arrow_mmap/arrow_aggregator.hpp"
+#include "arrow_mmap/arrow_dictionary.hpp"
 #include "arrow_mmap/arrow_meta.hpp"
 #include "arrow_mmap/arrow_reader.hpp"
+#include "arrow_mmap/arrow_replication.hpp"
 #include "arrow_mmap/arrow_writer.hpp"
 #include "arrow_mmap/manager.hpp"
 
 namespace arrow_mmap {
 
+/**
+ * @brief ArrowManager opens the files of a store and hands out its writers, reader and other components.
+ *
+ * Every component keeps the mappings it uses alive, so it stays valid after the ArrowManager is released.
+ */
 class ArrowManager {
  public:
   ArrowManager(const std::string& location, const MmapManagerOptions& options = {});
@@ -31,18 +39,39 @@ class ArrowManager {
    * @param array_length The array length of each RecordBatch.
    * @param schema The schema of the Arrow data.
    * @param capacity The number of RecordBatches (i.e., how many RecordBatches can be stored in total).
+   * @param dictionary The capacity of the dictionary file, only used when the schema has dictionary columns.
+   * @param layout How batches are laid out in the data file, column-major keeps a column contiguous across batches.
    */
   static ArrowManager create(const std::string& location, const size_t writer_count, const size_t array_length,
                              const size_t capacity, const std::shared_ptr<arrow::Schema> schema,
-                             const MmapManagerCreateOptions& options = {});
+                             const MmapManagerCreateOptions& options = {}, const DictionaryOptions& dictionary = {},
+                             const ArrowLayout layout = ArrowLayout::BATCH_MAJOR);
 
   /**
    * @brief Check if the ArrowManager is ready to use.
    *
    * @param location The directory where mmap files are stored.
+   * @param backend The backend of the store, a memfd store is never ready by location.
    * @return true if the ArrowManager is ready to use, false otherwise.
    */
-  static inline bool ready(const std::string& location) noexcept;
+  static bool ready(const std::string& location, const MmapBackend backend = MmapBackend::FILE) noexcept;
+
+  /**
+   * @brief Remove the files of a store, mappings which are still open keep their data alive.
+   *
+   * Shm stores outlive their processes until they are removed.
+   */
+  static void remove(const std::string& location, const MmapBackend backend = MmapBackend::FILE);
+
+  /**
+   * @brief Send this shm or memfd store over a connected unix socket, so another process can `receive` it.
+   */
+  void send(int socket) const;
+
+  /**
+   * @brief Receive a store sent with `send`, `options` apply as if the store was opened by location.
+   */
+  static ArrowManager receive(int socket, const MmapManagerOptions& options = {});
 
   /**
    * @brief Get the meta of the ArrowManager.
@@ -55,22 +84,68 @@ class ArrowManager {
    * @brief Get the ArrowWriter of the ArrowManager.
    *
    * @param id The id of the ArrowWriter.
+   * @param options The writer options, only used when the writer is created for the first time.
    * @return The ArrowWriter of the ArrowManager.
    */
-  const std::shared_ptr<ArrowWriter> writer(const size_t id) noexcept;
+  const std::shared_ptr<ArrowWriter> writer(const size_t id, const ArrowWriterOptions& options = {}) noexcept;
 
   /**
    * @brief Get the ArrowReader of the ArrowManager.
    *
+   * @param options The reader options, only used when the reader is created for the first time.
    * @return The ArrowReader of the ArrowManager.
    */
-  const std::shared_ptr<ArrowReader> reader() noexcept;
+  const std::shared_ptr<ArrowReader> reader(const ArrowReaderOptions& options = {}) noexcept;
+
+  /**
+   * @brief Get the dictionary shared by all dictionary columns.
+   *
+   * Use `ArrowDictionary::find` to turn an equality filter on a dictionary column into an integer compare.
+   *
+   * @return The ArrowDictionary of the ArrowManager, nullptr if the schema has no dictionary columns.
+   */
+  const std::shared_ptr<ArrowDictionary> dictionary() noexcept;
+
+  /**
+   * @brief Get the ArrowAggregator of the ArrowManager.
+   *
+   * @param threads The number of aggregation threads, only used when the aggregator is created for the first time.
+   * @return The ArrowAggregator of the ArrowManager.
+   */
+  const std::shared_ptr<ArrowAggregator> aggregator(const size_t threads = 0) noexcept;
+
+  /**
+   * @brief Get the ArrowShipper which replicates this store to followers.
+   *
+   * @param options The replication options, only used when the shipper is created for the first time.
+   * @return The ArrowShipper of the ArrowManager.
+   */
+  const std::shared_ptr<ArrowShipper> shipper(const ReplicationOptions& options = {}) noexcept;
+
+  /**
+   * @brief Get the ArrowFollower which applies batches from a shipper into this store.
+   *
+   * The store must not have local writers, and must be created with the same ArrowMeta as the leader.
+   *
+   * @param options The replication options, only used when the follower is created for the first time.
+   * @return The ArrowFollower of the ArrowManager.
+   */
+  const std::shared_ptr<ArrowFollower> follower(const ReplicationOptions& options = {}) noexcept;
+
+  /**
+   * @brief Get a snapshot of the counters of every writer and the reader of this process.
+   *
+   * Counters are only collected when the library is built with `ARROW_MMAP_METRICS`, otherwise they are all zero.
+   */
+  ArrowMetrics metrics() const noexcept;
 
  private:
   class Impl;
   friend class Impl;
+  friend class ArrowCatalog;
 
   ArrowManager(Impl* impl) : impl_(impl) {}
+  ArrowManager(MmapManager&& data_manager, MmapManager&& bitflag_manager, const ArrowMeta& meta);
 
   Impl* impl_;
 };
@@ -1,15 +1,19 @@
 #include "arrow_mmap/arrow_meta.hpp"
 
+#include <algorithm>
+#include <cstring>
 #include <fstream>
+#include <numeric>
 
 #include <arrow/io/api.h>
 #include <arrow/ipc/api.h>
+#include <libassert/assert.hpp>
 
 namespace arrow_mmap {
 
 std::string ArrowMeta::to_string() const {
-  return std::format("writer_count: {}\narray_length: {}\ncapacity: {}\nschema:\n{}", writer_count, array_length,
-                     capacity, [&] {
+  return std::format("writer_count: {}\narray_length: {}\ncapacity: {}\nlayout: {}\nschema:\n{}", writer_count,
+                     array_length, capacity, layout == ArrowLayout::COLUMN_MAJOR ? "column-major" : "batch-major", [&] {
                        std::string schema_str = schema->ToString();
                        std::string indented;
                        size_t pos = 0, prev = 0;
@@ -24,12 +28,132 @@ std::string ArrowMeta::to_string() const {
                      }());
 }
 
-void ArrowMeta::serialize(std::ofstream& ofs) const {
+bool ArrowMeta::has_dictionary() const {
+  return std::any_of(schema->fields().begin(), schema->fields().end(),
+                     [](const auto& field) { return field->type()->id() == arrow::Type::DICTIONARY; });
+}
+
+void ArrowMeta::validate() const {
+  ASSERT(writer_count > 0, "writer_count must be greater than 0");
+  ASSERT(array_length > 0, "array_length must be greater than 0");
+  ASSERT(capacity > 0, "capacity must be greater than 0");
+  ASSERT(!schema->fields().empty(), "schema must have at least one field");
+  ASSERT(writer_count <= array_length, "writer_count must be less than or equal to array_length");
+  for (const auto& field : schema->fields()) {
+    ASSERT(col_size(*field->type()) > 0, "column must have a fixed byte width, field: {}, type: {}", field->name(),
+           field->type()->ToString());
+    if (field->type()->id() != arrow::Type::DICTIONARY) continue;
+    auto value_type = static_cast<const arrow::DictionaryType&>(*field->type()).value_type()->id();
+    ASSERT(value_type == arrow::Type::STRING || value_type == arrow::Type::BINARY,
+           "dictionary values must be string or binary, field: {}", field->name());
+  }
+}
+
+size_t ArrowMeta::col_size(const arrow::DataType& type) {
+  if (type.id() == arrow::Type::FIXED_SIZE_LIST) {
+    const auto& list_type = static_cast<const arrow::FixedSizeListType&>(type);
+    return list_type.list_size() * col_size(*list_type.value_type());
+  }
+  // covers primitives, temporals, fixed-size binary, decimals and dictionaries, booleans are bit packed so they are 0
+  auto fixed_width_type = dynamic_cast<const arrow::FixedWidthType*>(&type);
+  if (fixed_width_type == nullptr) return 0;
+  return std::max(fixed_width_type->byte_width(), 0);
+}
+
+std::vector<size_t> ArrowMeta::col_sizes() const {
+  std::vector<size_t> col_sizes;
+  for (const auto& field : schema->fields()) {
+    col_sizes.push_back(col_size(*field->type()));
+  }
+  return col_sizes;
+}
+
+std::vector<size_t> ArrowMeta::col_offsets() const {
+  std::vector<size_t> col_offsets;
+  size_t offset = 0;
+  for (const auto& size : col_sizes()) {
+    col_offsets.push_back(offset);
+    // a column-major column spans all batches
+    offset += size * array_length * (layout == ArrowLayout::COLUMN_MAJOR ? capacity : 1);
+  }
+  return col_offsets;
+}
+
+std::vector<size_t> ArrowMeta::col_strides() const {
+  if (layout == ArrowLayout::BATCH_MAJOR) {
+    return std::vector<size_t>(schema->num_fields(), batch_size());
+  }
+  std::vector<size_t> col_strides;
+  for (const auto& size : col_sizes()) {
+    col_strides.push_back(size * array_length);
+  }
+  return col_strides;
+}
+
+size_t ArrowMeta::batch_size() const {
+  auto col_sizes = this->col_sizes();
+  return std::accumulate(col_sizes.begin(), col_sizes.end(), size_t(0)) * array_length;
+}
+
+std::vector<std::pair<size_t, size_t>> ArrowMeta::batch_ranges(size_t begin, size_t end) const {
+  if (layout == ArrowLayout::BATCH_MAJOR) {
+    auto batch_size = this->batch_size();
+    return {{begin * batch_size, (end - begin) * batch_size}};
+  }
+  std::vector<std::pair<size_t, size_t>> ranges;
+  auto col_offsets = this->col_offsets();
+  auto col_strides = this->col_strides();
+  for (size_t i = 0; i < col_offsets.size(); i++) {
+    ranges.emplace_back(col_offsets[i] + begin * col_strides[i], (end - begin) * col_strides[i]);
+  }
+  return ranges;
+}
+
+std::vector<std::pair<size_t, size_t>> ArrowMeta::writer_ranges(size_t id, size_t begin, size_t end,
+                                                                 size_t page_size) const {
+  // every writer but the last one writes `array_length / writer_count` rows, the last one the rest
+  auto rows = array_length / writer_count;
+  auto row_offset = id * rows;
+  if (id == writer_count - 1) rows = array_length - row_offset;
+
+  auto col_sizes = this->col_sizes();
+  auto col_offsets = this->col_offsets();
+  auto col_strides = this->col_strides();
+  std::vector<std::pair<size_t, size_t>> ranges;
+  auto push = [&](size_t i, size_t index) {
+    auto offset = col_offsets[i] + index * col_strides[i] + row_offset * col_sizes[i];
+    auto length = rows * col_sizes[i];
+    if (length == 0) return;
+    if (!ranges.empty()) {
+      auto& [last_offset, last_length] = ranges.back();
+      if (offset >= last_offset && offset / page_size <= (last_offset + last_length) / page_size) {
+        last_length = std::max(last_length, offset + length - last_offset);
+        return;
+      }
+    }
+    ranges.emplace_back(offset, length);
+  };
+  // visit the slices in file order
+  if (layout == ArrowLayout::BATCH_MAJOR) {
+    for (auto index = begin; index < end; index++) {
+      for (size_t i = 0; i < col_sizes.size(); i++) push(i, index);
+    }
+  } else {
+    for (size_t i = 0; i < col_sizes.size(); i++) {
+      for (auto index = begin; index < end; index++) push(i, index);
+    }
+  }
+  return ranges;
+}
+
+void ArrowMeta::serialize(std::ostream& ofs) const {
   auto schema_buffer = arrow::ipc::SerializeSchema(*schema).ValueOrDie();
   ofs.write(reinterpret_cast<const char*>(&writer_count), sizeof(size_t));
   ofs.write(reinterpret_cast<const char*>(&array_length), sizeof(size_t));
   ofs.write(reinterpret_cast<const char*>(&capacity), sizeof(size_t));
   ofs.write(reinterpret_cast<const char*>(schema_buffer->data()), schema_buffer->size());
+  // the layout follows the schema, so meta written before it was added still reads as batch-major
+  ofs.write(reinterpret_cast<const char*>(&layout), sizeof(ArrowLayout));
 }
 
 void ArrowMeta::serialize(const std::string& output_file) const {
@@ -38,7 +162,7 @@ void ArrowMeta::serialize(const std::string& output_file) const {
   ofs.close();
 }
 
-ArrowMeta ArrowMeta::deserialize(std::ifstream& ifs) {
+ArrowMeta ArrowMeta::deserialize(std::istream& ifs) {
   ArrowMeta meta;
   ifs.read(reinterpret_cast<char*>(&meta.writer_count), sizeof(size_t));
   ifs.read(reinterpret_cast<char*>(&meta.array_length), sizeof(size_t));
@@ -48,6 +172,10 @@ ArrowMeta ArrowMeta::deserialize(std::ifstream& ifs) {
   auto schema_buffer = arrow::Buffer::FromString(std::string(schema_data.begin(), schema_data.end()));
   auto reader = arrow::io::BufferReader(schema_buffer);
   meta.schema = arrow::ipc::ReadSchema(&reader, nullptr).ValueOrDie();
+  auto position = static_cast<size_t>(reader.Tell().ValueOrDie());
+  if (position + sizeof(ArrowLayout) <= schema_data.size()) {
+    std::memcpy(&meta.layout, schema_data.data() + position, sizeof(ArrowLayout));
+  }
   return meta;
 }
 
@@ -3,20 +3,73 @@
 #pragma once
 
 #include <arrow/api.h>
+#include <iosfwd>
 
 namespace arrow_mmap {
 
+enum class ArrowLayout : uint64_t {
+  // the columns of a batch are stored next to each other, batch after batch
+  BATCH_MAJOR = 0,
+  // every column is stored contiguously across all batches, so a batch range of a column is a single array
+  COLUMN_MAJOR = 1,
+};
+
 struct ArrowMeta {
   size_t writer_count;
   size_t array_length;
   size_t capacity;
   std::shared_ptr<arrow::Schema> schema;
+  ArrowLayout layout = ArrowLayout::BATCH_MAJOR;
 
   std::string to_string() const;
 
-  void serialize(std::ofstream& ofs) const;
+  // whether any column is dictionary encoded, i.e. the store needs a dictionary file
+  bool has_dictionary() const;
+
+  /**
+   * @brief Assert that the meta describes a store which can be created.
+   *
+   * Every column must have a fixed byte width, and dictionary columns must have string or binary values.
+   */
+  void validate() const;
+
+  /**
+   * @brief The byte size of one value of a column type, or 0 if values of the type don't have a fixed byte size.
+   *
+   * Fixed-size lists are stored as their flattened values, so one value is `list_size` values of the list type, and
+   * dictionary columns are stored as their indices.
+   */
+  static size_t col_size(const arrow::DataType& type);
+
+  // the byte size of one value of every column
+  std::vector<size_t> col_sizes() const;
+  // the byte offset of every column of the first batch, column `i` of batch `index` is at
+  // `col_offsets()[i] + index * col_strides()[i]`
+  std::vector<size_t> col_offsets() const;
+  // the byte distance between a column of two consecutive batches
+  std::vector<size_t> col_strides() const;
+  // the byte size of a batch, i.e. `array_length` rows of every column
+  size_t batch_size() const;
+
+  /**
+   * @brief The byte ranges holding the batches [begin, end) as (offset, length) pairs.
+   *
+   * A batch range is one range in batch-major layout, and one range per column in column-major layout.
+   */
+  std::vector<std::pair<size_t, size_t>> batch_ranges(size_t begin, size_t end) const;
+
+  /**
+   * @brief The byte ranges holding the rows of writer `id` in the batches [begin, end) as (offset, length) pairs.
+   *
+   * Ranges are merged when the next one starts in the `page_size` page where the previous one ends, so a caller
+   * syncing them issues one call per run of pages without touching pages only other writers wrote.
+   */
+  std::vector<std::pair<size_t, size_t>> writer_ranges(size_t id, size_t begin, size_t end,
+                                                       size_t page_size = 1) const;
+
+  void serialize(std::ostream& ofs) const;
   void serialize(const std::string& output_file) const;
-  static ArrowMeta deserialize(std::ifstream& ifs);
+  static ArrowMeta deserialize(std::istream& ifs);
   static ArrowMeta deserialize(const std::string& input_file);
 };
 
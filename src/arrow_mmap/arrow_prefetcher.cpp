@@ -0,0 +1,96 @@
+#include "arrow_mmap/arrow_prefetcher.hpp"
+
+#include <algorithm>
+#include <cerrno>
+
+#include <unistd.h>
+
+namespace arrow_mmap {
+
+ArrowPrefetcher::ArrowPrefetcher(const IMmapReader* data_reader, const ArrowMeta& meta, const PrefetchOptions& options)
+    : data_reader_(data_reader),
+      meta_(meta),
+      options_(options),
+      page_size_(sysconf(_SC_PAGESIZE)),
+      ahead_advice_(options.ahead_advice),
+      thread_([this]() { loop(); }) {}
+
+ArrowPrefetcher::~ArrowPrefetcher() {
+  {
+    std::lock_guard lock(mutex_);
+    stop_.store(true, std::memory_order_release);
+  }
+  cv_.notify_one();
+  thread_.join();
+}
+
+void ArrowPrefetcher::wake() {
+  // an empty critical section, so the notify can't slip in between the thread's predicate check and its wait
+  { std::lock_guard lock(mutex_); }
+  cv_.notify_one();
+}
+
+void ArrowPrefetcher::loop() {
+  // batches in [prefetched_begin, prefetched_end) are already advised with `ahead_advice_`
+  size_t prefetched_begin = 0;
+  size_t prefetched_end = 0;
+  // batches before `released_end` are already advised with `behind_advice`
+  size_t released_end = 0;
+
+  while (!stop_.load(std::memory_order_acquire)) {
+    auto cursor = cursor_.load(std::memory_order_acquire);
+
+    // the cursor jumped out of the prefetched window, start a new one
+    if (cursor < prefetched_begin || cursor > prefetched_end) {
+      prefetched_begin = prefetched_end = cursor;
+    }
+    auto ahead_end = std::min(meta_.capacity, cursor + options_.ahead);
+    if (prefetched_end < ahead_end) {
+      advise(prefetched_end, ahead_end, ahead_advice_, true);
+      prefetched_end = ahead_end;
+    }
+    prefetched_begin = cursor;
+
+    auto behind_end = cursor > options_.behind ? cursor - options_.behind : 0;
+    if (released_end < behind_end) {
+      advise(released_end, behind_end, options_.behind_advice, false);
+    }
+    released_end = behind_end;
+
+    // sleep until the cursor gets close to the prefetched end or leaves the window
+    auto margin = std::max<size_t>(1, options_.ahead / 2);
+    wake_begin_.store(prefetched_begin, std::memory_order_relaxed);
+    // nothing is left to prefetch at the end of the store, the poll interval still releases the batches behind
+    auto wake_end = prefetched_end >= meta_.capacity ? SIZE_MAX : prefetched_end - std::min(margin, prefetched_end);
+    wake_end_.store(wake_end, std::memory_order_relaxed);
+    armed_.store(true, std::memory_order_release);
+    // the cursor may have moved before the bounds were visible, the poll interval bounds how long that goes unseen
+    std::unique_lock lock(mutex_);
+    cv_.wait_for(lock, options_.poll_interval, [this]() {
+      return stop_.load(std::memory_order_acquire) || !armed_.load(std::memory_order_acquire);
+    });
+  }
+}
+
+void ArrowPrefetcher::advise(size_t begin, size_t end, int advice, bool round_up) {
+  auto base = reinterpret_cast<uintptr_t>(data_reader_->mmap_addr());
+  for (const auto& [offset, length] : meta_.batch_ranges(begin, end)) {
+    // madvise requires a page aligned address, and a slice may start in the middle of a page
+    auto begin_addr = (base + offset) / page_size_ * page_size_;
+    auto end_addr = base + std::min(offset + length, data_reader_->length());
+    end_addr = round_up ? (end_addr + page_size_ - 1) / page_size_ * page_size_ : end_addr / page_size_ * page_size_;
+    if (end_addr <= begin_addr) continue;
+
+    auto addr = reinterpret_cast<void*>(begin_addr);
+    auto advise_length = end_addr - begin_addr;
+    // advice is only a hint, the reader is still correct if it fails
+    if (madvise(addr, advise_length, advice) == -1 && errno == EINVAL && advice == ahead_advice_ &&
+        ahead_advice_ != MADV_WILLNEED) {
+      // MADV_POPULATE_READ is not supported before linux 5.14
+      ahead_advice_ = MADV_WILLNEED;
+      madvise(addr, advise_length, ahead_advice_);
+    }
+  }
+}
+
+}  // namespace arrow_mmap
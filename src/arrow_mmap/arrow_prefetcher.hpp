@@ -0,0 +1,96 @@
+#ifndef ARROW_MMAP_ARROW_PREFETCHER_HPP
+#define ARROW_MMAP_ARROW_PREFETCHER_HPP
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+
+#include "arrow_mmap/arrow_meta.hpp"
+#include "arrow_mmap/interface.hpp"
+#include "sys/mman.h"
+
+namespace arrow_mmap {
+
+struct PrefetchOptions {
+  // the number of batches to prefetch ahead of the cursor, 0 disables the prefetcher
+  size_t ahead = 0;
+  // the number of batches to keep resident behind the cursor, older batches are released with `behind_advice`
+  size_t behind = 1;
+#ifdef MADV_POPULATE_READ
+  int ahead_advice = MADV_POPULATE_READ;
+#else
+  int ahead_advice = MADV_WILLNEED;
+#endif
+#ifdef MADV_COLD
+  int behind_advice = MADV_COLD;
+#else
+  int behind_advice = MADV_DONTNEED;
+#endif
+  // the background thread rechecks the cursor at least this often, even if the reader never wakes it
+  std::chrono::milliseconds poll_interval{10};
+};
+
+/**
+ * @brief ArrowPrefetcher keeps a window of batches around a read cursor resident.
+ *
+ * The reader publishes its cursor with `advance`, which is a single atomic store. A background thread then applies
+ * `ahead_advice` to the byte ranges of the next `ahead` batches and `behind_advice` to the batches which fell more than
+ * `behind` batches behind the cursor, so sequential reads don't take major faults and RSS stays bounded.
+ *
+ * The reader only wakes the thread once the cursor gets within `ahead / 2` batches of the prefetched end or jumps out
+ * of the prefetched window, so most reads don't touch the mutex or issue a syscall.
+ *
+ * Map the data file with `MADV_NORMAL` or `MADV_RANDOM` when using the prefetcher, whole-file `MADV_WILLNEED` defeats
+ * the purpose on stores larger than RAM.
+ */
+class ArrowPrefetcher {
+ public:
+  ArrowPrefetcher(const IMmapReader* data_reader, const ArrowMeta& meta, const PrefetchOptions& options);
+  ~ArrowPrefetcher();
+
+  // disable copy and assign
+  ArrowPrefetcher(const ArrowPrefetcher&) = delete;
+  ArrowPrefetcher& operator=(const ArrowPrefetcher&) = delete;
+
+  /**
+   * @brief Move the cursor to `index`, i.e. the next batch the reader is going to read.
+   */
+  inline void advance(const size_t index) noexcept {
+    cursor_.store(index, std::memory_order_release);
+    // the thread disarms itself here, so at most one read per arming pays for the wakeup
+    if (armed_.load(std::memory_order_acquire) &&
+        (index < wake_begin_.load(std::memory_order_relaxed) || index >= wake_end_.load(std::memory_order_relaxed)) &&
+        armed_.exchange(false, std::memory_order_acq_rel)) {
+      wake();
+    }
+  }
+
+ private:
+  void wake();
+  void loop();
+  void advise(size_t begin, size_t end, int advice, bool round_up);
+
+  const IMmapReader* data_reader_;
+  const ArrowMeta meta_;
+  const PrefetchOptions options_;
+  const size_t page_size_;
+  int ahead_advice_;
+
+  std::atomic<size_t> cursor_{0};
+  // the reader wakes the thread when the cursor leaves [wake_begin_, wake_end_) while armed
+  std::atomic<size_t> wake_begin_{0};
+  std::atomic<size_t> wake_end_{0};
+  std::atomic<bool> armed_{false};
+  std::atomic<bool> stop_{false};
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::thread thread_;
+};
+
+}  // namespace arrow_mmap
+
+#endif  // ARROW_MMAP_ARROW_PREFETCHER_HPP
@@ -2,6 +2,8 @@
 
 #include <libassert/assert.hpp>
 
+#include "arrow_mmap/bitflag.hpp"
+
 namespace arrow_mmap {
 
 inline ArrowType as_nanoarrow_type(arrow::Type::type type) {
@@ -93,50 +95,90 @@ inline ArrowType as_nanoarrow_type(arrow::Type::type type) {
   }
 }
 
-ArrowReader::ArrowReader(const ArrowMeta meta, const IMmapReader* data_reader, const IMmapReader* bitflag_reader)
+// set the type of an initialized `schema`, including the children of fixed-size lists and the dictionary values
+static void set_schema_type(ArrowSchema* schema, const arrow::DataType& type) {
+  switch (type.id()) {
+    case arrow::Type::FIXED_SIZE_BINARY:
+      NANOARROW_THROW_NOT_OK(ArrowSchemaSetTypeFixedSize(
+          schema, NANOARROW_TYPE_FIXED_SIZE_BINARY, static_cast<const arrow::FixedSizeBinaryType&>(type).byte_width()));
+      break;
+    case arrow::Type::DECIMAL128:
+    case arrow::Type::DECIMAL256: {
+      const auto& decimal_type = static_cast<const arrow::DecimalType&>(type);
+      NANOARROW_THROW_NOT_OK(ArrowSchemaSetTypeDecimal(schema, as_nanoarrow_type(type.id()), decimal_type.precision(),
+                                                       decimal_type.scale()));
+      break;
+    }
+    case arrow::Type::FIXED_SIZE_LIST: {
+      const auto& list_type = static_cast<const arrow::FixedSizeListType&>(type);
+      // this also initializes the child schema named "item"
+      NANOARROW_THROW_NOT_OK(
+          ArrowSchemaSetTypeFixedSize(schema, NANOARROW_TYPE_FIXED_SIZE_LIST, list_type.list_size()));
+      set_schema_type(schema->children[0], *list_type.value_type());
+      break;
+    }
+    case arrow::Type::DICTIONARY: {
+      // a dictionary column is stored as its indices
+      const auto& dictionary_type = static_cast<const arrow::DictionaryType&>(type);
+      NANOARROW_THROW_NOT_OK(ArrowSchemaSetType(schema, as_nanoarrow_type(dictionary_type.index_type()->id())));
+      NANOARROW_THROW_NOT_OK(ArrowSchemaAllocateDictionary(schema));
+      NANOARROW_THROW_NOT_OK(
+          ArrowSchemaInitFromType(schema->dictionary, as_nanoarrow_type(dictionary_type.value_type()->id())));
+      break;
+    }
+    default:
+      NANOARROW_THROW_NOT_OK(ArrowSchemaSetType(schema, as_nanoarrow_type(type.id())));
+  }
+}
+
+// point `array` at `length` values of `type` starting at `addr`, the values of nested lists are laid out flattened
+static void set_array_values(ArrowArray* array, const arrow::DataType& type, const std::byte* addr,
+                             const int64_t length) {
+  array->length = length;
+  // do not release the buffer
+  array->release = nullptr;
+  if (type.id() == arrow::Type::FIXED_SIZE_LIST) {
+    const auto& list_type = static_cast<const arrow::FixedSizeListType&>(type);
+    set_array_values(array->children[0], *list_type.value_type(), addr, length * list_type.list_size());
+  } else {
+    array->buffers[1] = reinterpret_cast<const void*>(addr);
+  }
+}
+
+ArrowReader::ArrowReader(const ArrowMeta meta, const IMmapReader* data_reader, const IMmapReader* bitflag_reader,
+                         const ArrowDictionary* dictionary, const ArrowReaderOptions& options)
     : meta_(meta),
       data_reader_(data_reader),
       bitflag_reader_(bitflag_reader),
-      batch_size_(std::accumulate(meta_.schema->fields().begin(), meta_.schema->fields().end(), 0,
-                                  [](size_t acc, const auto& field) { return acc + field->type()->byte_width(); })),
-      col_sizes_([&]() {
-        std::vector<size_t> col_sizes;
-        for (const auto& field : meta.schema->fields()) {
-          col_sizes.push_back(field->type()->byte_width());
-        }
-        return col_sizes;
-      }()),
-      col_types_([&]() {
-        std::vector<ArrowType> col_types;
-        for (const auto& field : meta.schema->fields()) {
-          col_types.push_back(as_nanoarrow_type(field->type()->id()));
-        }
-        return col_types;
-      }()),
+      dictionary_(dictionary),
+      col_sizes_(meta_.col_sizes()),
+      col_offsets_(meta_.col_offsets()),
+      col_strides_(meta_.col_strides()),
       schema_([&]() {
         nanoarrow::UniqueSchema schema;
 
         NANOARROW_THROW_NOT_OK(ArrowSchemaInitFromType(schema.get(), NANOARROW_TYPE_STRUCT));
-        NANOARROW_THROW_NOT_OK(ArrowSchemaAllocateChildren(schema.get(), col_types_.size()));
+        NANOARROW_THROW_NOT_OK(ArrowSchemaAllocateChildren(schema.get(), col_sizes_.size()));
 
         auto& fields = meta.schema->fields();
-        for (size_t i = 0; i < col_types_.size(); i++) {
+        for (size_t i = 0; i < col_sizes_.size(); i++) {
           auto& field = fields[i];
-          NANOARROW_THROW_NOT_OK(ArrowSchemaInitFromType(schema->children[i], col_types_[i]));
+          ArrowSchemaInit(schema->children[i]);
+          set_schema_type(schema->children[i], *field->type());
           NANOARROW_THROW_NOT_OK(ArrowSchemaSetName(schema->children[i], field->name().c_str()));
         }
         return schema;
       }()),
       struct_array_([&]() {
+        ASSERT(!meta.has_dictionary() || dictionary_ != nullptr, "reader has no dictionary");
+        // the array tree mirrors the schema, nested and dictionary children included
         nanoarrow::UniqueArray struct_array;
-        NANOARROW_THROW_NOT_OK(ArrowArrayInitFromType(struct_array.get(), NANOARROW_TYPE_STRUCT));
-        NANOARROW_THROW_NOT_OK(ArrowArrayAllocateChildren(struct_array.get(), col_types_.size()));
-
-        for (size_t i = 0; i < col_types_.size(); i++) {
-          NANOARROW_THROW_NOT_OK(ArrowArrayInitFromType(struct_array->children[i], col_types_[i]));
-        }
+        NANOARROW_THROW_NOT_OK(ArrowArrayInitFromSchema(struct_array.get(), schema_.get(), nullptr));
         return struct_array;
-      }()) {}
+      }()),
+      prefetcher_(options.prefetch.ahead > 0
+                      ? std::make_unique<ArrowPrefetcher>(data_reader, meta, options.prefetch)
+                      : nullptr) {}
 
 bool ArrowReader::read(nanoarrow::UniqueArrayStream& stream) {
   auto ret = read(stream, index_);
@@ -146,26 +188,54 @@ bool ArrowReader::read(nanoarrow::UniqueArrayStream& stream) {
 
 bool ArrowReader::read(nanoarrow::UniqueArrayStream& stream, const size_t index) {
   ASSERT(index < meta_.capacity, "index out of range, index: {}, capacity: {}", index, meta_.capacity);
+  return read(stream, index, index + 1);
+}
 
-  auto bitflag_addr = bitflag_reader_->mmap_addr() + index * meta_.writer_count;
-  if (!std::all_of(bitflag_addr, bitflag_addr + meta_.writer_count,
-                   [](const std::byte& b) { return b == std::byte(0xff); })) {
-    return false;
+bool ArrowReader::read(nanoarrow::UniqueArrayStream& stream, const size_t begin, const size_t end) {
+  ASSERT(begin < end && end <= meta_.capacity, "invalid batch range, begin: {}, end: {}, capacity: {}", begin, end,
+         meta_.capacity);
+  ASSERT(end - begin == 1 || meta_.layout == ArrowLayout::COLUMN_MAJOR,
+         "only a column-major store reads a batch range as one array, begin: {}, end: {}", begin, end);
+
+  auto start = metrics::now();
+  auto ret = read_range(stream, begin, end);
+  if (ret) {
+    metrics::add(metrics_.batches, end - begin);
+    ARROW_MMAP_PROBE2(consume, begin, end);
+  } else {
+    metrics::add(metrics_.not_ready, 1);
   }
+  metrics::add(metrics_.read_ns, metrics::now() - start);
+  return ret;
+}
 
-  auto data_addr = data_reader_->mmap_addr() + index * batch_size_;
+bool ArrowReader::read_range(nanoarrow::UniqueArrayStream& stream, const size_t begin, const size_t end) {
+  auto bitflag_addr = bitflag_reader_->mmap_addr() + begin * meta_.writer_count;
+  if (!bitflag::written(bitflag_addr, (end - begin) * meta_.writer_count)) return false;
+
+  // every index of these batches was interned before the release store of their bitflags, which the acquire loads
+  // above pair with, so this snapshot covers all of them
+  auto dictionary_size = dictionary_ ? dictionary_->size() : 0;
+
+  const int64_t length = (end - begin) * meta_.array_length;
   for (size_t i = 0; i < col_sizes_.size(); i++) {
-    struct_array_->children[i]->buffers[1] = reinterpret_cast<const void*>(data_addr);
-    struct_array_->children[i]->length = meta_.array_length;
-    // do not release the buffer
-    struct_array_->children[i]->release = nullptr;
-    data_addr += col_sizes_[i] * meta_.array_length;
+    auto col_addr = data_reader_->range(col_offsets_[i] + begin * col_strides_[i], col_sizes_[i] * length);
+    set_array_values(struct_array_->children[i], *meta_.schema->field(i)->type(), col_addr, length);
+    if (auto dictionary = struct_array_->children[i]->dictionary) {
+      // the dictionary is a view of the shared dictionary file
+      dictionary->buffers[1] = dictionary_->offsets();
+      dictionary->buffers[2] = dictionary_->data();
+      dictionary->length = dictionary_size;
+      dictionary->release = nullptr;
+    }
   }
-  struct_array_->length = meta_.array_length;
+  struct_array_->length = length;
 
   NANOARROW_THROW_NOT_OK(ArrowBasicArrayStreamInit(stream.get(), schema_.get(), 1));
   ArrowBasicArrayStreamSetArray(stream.get(), 0, struct_array_.get());
 
+  if (prefetcher_) prefetcher_->advance(end);
+
   return true;
 }
 }  // namespace arrow_mmap
@@ -4,30 +4,61 @@
 
 #include <nanoarrow/nanoarrow.hpp>
 
+#include "arrow_mmap/arrow_dictionary.hpp"
 #include "arrow_mmap/arrow_meta.hpp"
+#include "arrow_mmap/arrow_prefetcher.hpp"
 #include "arrow_mmap/interface.hpp"
+#include "arrow_mmap/metrics.hpp"
 
 namespace arrow_mmap {
+
+struct ArrowReaderOptions {
+  PrefetchOptions prefetch = {};
+};
+
 class ArrowReader {
  public:
-  ArrowReader(const ArrowMeta meta, const IMmapReader* data_reader, const IMmapReader* bitflag_reader);
+  /**
+   * @param dictionary The shared dictionary, required when the schema has dictionary columns.
+   */
+  ArrowReader(const ArrowMeta meta, const IMmapReader* data_reader, const IMmapReader* bitflag_reader,
+              const ArrowDictionary* dictionary = nullptr, const ArrowReaderOptions& options = {});
 
   bool read(nanoarrow::UniqueArrayStream& stream);
   bool read(nanoarrow::UniqueArrayStream& stream, const size_t index);
 
+  /**
+   * @brief Read the batches [begin, end) as one array of `(end - begin) * array_length` rows without copying.
+   *
+   * Only column-major stores keep a column of consecutive batches contiguous, batch-major stores read one batch.
+   *
+   * @return false if any batch of the range is not fully written.
+   */
+  bool read(nanoarrow::UniqueArrayStream& stream, const size_t begin, const size_t end);
+
   const size_t current_index() const noexcept { return index_; }
 
+  /**
+   * @brief A snapshot of the counters, safe to take from any thread.
+   */
+  ReaderMetrics metrics() const noexcept { return metrics::snapshot(metrics_); }
+
  private:
+  bool read_range(nanoarrow::UniqueArrayStream& stream, const size_t begin, const size_t end);
+
   const ArrowMeta meta_;
   const IMmapReader* data_reader_;
   const IMmapReader* bitflag_reader_;
-  const size_t batch_size_;
+  const ArrowDictionary* dictionary_;
   const std::vector<size_t> col_sizes_;
-  const std::vector<ArrowType> col_types_;
+  const std::vector<size_t> col_offsets_;
+  const std::vector<size_t> col_strides_;
 
   size_t index_ = 0;
   nanoarrow::UniqueSchema schema_;
   nanoarrow::UniqueArray struct_array_;
+  std::unique_ptr<ArrowPrefetcher> prefetcher_;
+  ReaderMetrics metrics_;
 };
 }  // namespace arrow_mmap
 #endif  // ARROW_MMAP_ARROW_READER_HPP
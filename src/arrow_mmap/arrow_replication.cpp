@@ -0,0 +1,365 @@
+#include "arrow_mmap/arrow_replication.hpp"
+
+#include <cstring>
+#include <libassert/assert.hpp>
+
+#include <arrow/ipc/api.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "arrow_mmap/bitflag.hpp"
+
+namespace arrow_mmap {
+
+static const uint64_t REPLICATION_MAGIC = 0x4c5045524d4d5241;  // "ARMMREPL"
+
+struct ReplicationHello {
+  uint64_t magic;
+  uint64_t fingerprint;
+  uint64_t next_index;
+};
+
+struct ReplicationAck {
+  uint64_t magic;
+  uint64_t accepted;
+};
+
+// FNV-1a over everything which determines the byte layout of the store
+static uint64_t layout_fingerprint(const ArrowMeta& meta) {
+  uint64_t hash = 0xcbf29ce484222325;
+  auto update = [&hash](const void* data, size_t length) {
+    auto bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < length; i++) {
+      hash = (hash ^ bytes[i]) * 0x100000001b3;
+    }
+  };
+  update(&meta.writer_count, sizeof(size_t));
+  update(&meta.array_length, sizeof(size_t));
+  update(&meta.capacity, sizeof(size_t));
+  auto schema_buffer = arrow::ipc::SerializeSchema(*meta.schema).ValueOrDie();
+  update(schema_buffer->data(), schema_buffer->size());
+  update(&meta.layout, sizeof(ArrowLayout));
+  return hash;
+}
+
+static bool batch_written(const std::byte* bitflag_addr, const size_t writer_count, const size_t index) {
+  return bitflag::written(bitflag_addr + index * writer_count, writer_count);
+}
+
+/**
+ * Open a stream socket for `endpoint`, either listening on it or connected to it.
+ *
+ * @return The socket fd, or -1 if connecting failed. Failing to listen is fatal.
+ */
+static int open_endpoint(const std::string& endpoint, const bool listening) {
+  if (endpoint.starts_with("unix:")) {
+    auto path = endpoint.substr(5);
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    ASSERT(path.size() < sizeof(addr.sun_path), std::format("unix socket path is too long: {}", path));
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    ASSERT(fd != -1, std::format("failed to create socket: {}, error: {}", endpoint, strerror(errno)));
+    if (listening) {
+      unlink(path.c_str());
+      ASSERT(-1 != bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)),
+             std::format("failed to bind: {}, error: {}", endpoint, strerror(errno)));
+      ASSERT(-1 != listen(fd, SOMAXCONN), std::format("failed to listen: {}, error: {}", endpoint, strerror(errno)));
+    } else if (-1 == connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr))) {
+      close(fd);
+      return -1;
+    }
+    return fd;
+  }
+
+  ASSERT(endpoint.starts_with("tcp:"), std::format("unsupported endpoint: {}", endpoint));
+  auto address = endpoint.substr(4);
+  auto colon = address.rfind(':');
+  ASSERT(colon != std::string::npos, std::format("endpoint has no port: {}", endpoint));
+  auto host = address.substr(0, colon);
+  auto port = address.substr(colon + 1);
+
+  addrinfo hints{};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = listening ? AI_PASSIVE : 0;
+  addrinfo* result = nullptr;
+  if (0 != getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &result)) {
+    ASSERT(!listening, std::format("failed to resolve: {}", endpoint));
+    return -1;
+  }
+
+  int fd = -1;
+  for (auto info = result; info != nullptr; info = info->ai_next) {
+    fd = socket(info->ai_family, info->ai_socktype | SOCK_CLOEXEC, info->ai_protocol);
+    if (fd == -1) continue;
+    int on = 1;
+    if (listening) {
+      setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+      if (0 == bind(fd, info->ai_addr, info->ai_addrlen) && 0 == listen(fd, SOMAXCONN)) break;
+    } else if (0 == connect(fd, info->ai_addr, info->ai_addrlen)) {
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+      break;
+    }
+    close(fd);
+    fd = -1;
+  }
+  freeaddrinfo(result);
+  ASSERT(!listening || fd != -1, std::format("failed to listen: {}, error: {}", endpoint, strerror(errno)));
+  return fd;
+}
+
+/**
+ * @param flags Extra send flags, `MSG_MORE` keeps a short message corked until the rest of the batch follows.
+ */
+static bool send_all(int fd, const void* data, size_t length, const int flags = 0) {
+  auto bytes = static_cast<const std::byte*>(data);
+  while (length > 0) {
+    auto n = send(fd, bytes, length, MSG_NOSIGNAL | flags);
+    if (n == -1 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    bytes += n;
+    length -= n;
+  }
+  return true;
+}
+
+static bool recv_all(int fd, void* data, size_t length) {
+  auto bytes = static_cast<std::byte*>(data);
+  while (length > 0) {
+    auto n = recv(fd, bytes, length, 0);
+    if (n == -1 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    bytes += n;
+    length -= n;
+  }
+  return true;
+}
+
+ArrowShipper::ArrowShipper(const ArrowMeta meta, const IMmapReader* data_reader, const IMmapReader* bitflag_reader,
+                           const ReplicationOptions& options)
+    : meta_(meta),
+      data_reader_(data_reader),
+      bitflag_reader_(bitflag_reader),
+      options_(options),
+      fingerprint_(layout_fingerprint(meta)) {}
+
+ArrowShipper::~ArrowShipper() { stop(); }
+
+void ArrowShipper::start(const std::string& endpoint) {
+  ASSERT(!running_, "shipper is already running");
+  listen_fd_ = open_endpoint(endpoint, true);
+  running_ = true;
+  accept_thread_ = std::thread([this]() { accept_loop(); });
+}
+
+void ArrowShipper::stop() {
+  if (!running_.exchange(false)) return;
+
+  // wake up accept and every blocking send
+  shutdown(listen_fd_, SHUT_RDWR);
+  accept_thread_.join();
+  close(listen_fd_);
+  listen_fd_ = -1;
+  {
+    std::lock_guard lock(mutex_);
+    for (auto fd : connections_) {
+      shutdown(fd, SHUT_RDWR);
+    }
+  }
+  for (auto& thread : connection_threads_) {
+    thread.join();
+  }
+  connection_threads_.clear();
+  finished_threads_.clear();
+}
+
+void ArrowShipper::accept_loop() {
+  while (running_) {
+    int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd == -1) {
+      if (errno == EINTR || errno == ECONNABORTED) continue;
+      break;
+    }
+
+    // the index is a tiny write ahead of every batch, it must not wait for the ack of the previous batch
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+    std::lock_guard lock(mutex_);
+    // join the connections which ended since, so reconnecting followers don't pile up threads
+    for (auto id : finished_threads_) {
+      auto it = std::find_if(connection_threads_.begin(), connection_threads_.end(),
+                             [id](const std::thread& thread) { return thread.get_id() == id; });
+      if (it == connection_threads_.end()) continue;
+      it->join();
+      connection_threads_.erase(it);
+    }
+    finished_threads_.clear();
+    connections_.push_back(fd);
+    connection_threads_.emplace_back([this, fd]() { serve(fd); });
+  }
+}
+
+bool ArrowShipper::send_batch(int fd, const size_t index) {
+  // a batch is one range in batch-major layout and one range per column in column-major layout, every send but the
+  // last is corked so the index and the ranges leave in full segments
+  auto ranges = meta_.batch_ranges(index, index + 1);
+  if (!send_all(fd, &index, sizeof(index), MSG_MORE)) return false;
+  for (size_t i = 0; i < ranges.size(); i++) {
+    const auto& [offset, length] = ranges[i];
+    if (!send_all(fd, data_reader_->range(offset, length), length, i + 1 < ranges.size() ? MSG_MORE : 0)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void ArrowShipper::serve(int fd) {
+  ReplicationHello hello;
+  if (recv_all(fd, &hello, sizeof(hello)) && hello.magic == REPLICATION_MAGIC) {
+    ReplicationAck ack{.magic = REPLICATION_MAGIC, .accepted = hello.fingerprint == fingerprint_};
+    if (send_all(fd, &ack, sizeof(ack)) && ack.accepted) {
+      auto bitflag_addr = bitflag_reader_->mmap_addr();
+      for (uint64_t index = hello.next_index; running_ && index < meta_.capacity;) {
+        if (!batch_written(bitflag_addr, meta_.writer_count, index)) {
+          std::this_thread::sleep_for(options_.poll_interval);
+          continue;
+        }
+        // ship straight from the mapping, the batch is never copied or decoded on the leader
+        if (!send_batch(fd, index)) break;
+        index++;
+      }
+    }
+  }
+
+  // the thread never takes the mutex again, so the accept loop can join it as soon as it sees the id
+  std::lock_guard lock(mutex_);
+  std::erase(connections_, fd);
+  close(fd);
+  if (running_) finished_threads_.push_back(std::this_thread::get_id());
+}
+
+ArrowFollower::ArrowFollower(const ArrowMeta meta, const IMmapWriter* data_writer, const IMmapWriter* bitflag_writer,
+                             const ReplicationOptions& options)
+    : meta_(meta),
+      data_writer_(data_writer),
+      bitflag_writer_(bitflag_writer),
+      options_(options),
+      fingerprint_(layout_fingerprint(meta)) {}
+
+ArrowFollower::~ArrowFollower() { stop(); }
+
+void ArrowFollower::start(const std::string& endpoint) {
+  ASSERT(!running_, "follower is already running");
+
+  // catch up from the first batch which is not applied yet
+  size_t index = 0;
+  auto bitflag_addr = bitflag_writer_->mmap_addr();
+  while (index < meta_.capacity && batch_written(bitflag_addr, meta_.writer_count, index)) index++;
+  next_index_ = index;
+
+  running_ = true;
+  status_ = FollowerStatus::CONNECTING;
+  thread_ = std::thread([this, endpoint]() { loop(endpoint); });
+}
+
+void ArrowFollower::stop() {
+  if (!running_.exchange(false)) return;
+  {
+    std::lock_guard lock(mutex_);
+    if (fd_ != -1) shutdown(fd_, SHUT_RDWR);
+  }
+  thread_.join();
+  // a follower which completed or was rejected keeps telling why it stopped
+  auto status = status_.load();
+  if (status == FollowerStatus::CONNECTING || status == FollowerStatus::FOLLOWING) status_ = FollowerStatus::STOPPED;
+}
+
+std::string ArrowFollower::last_error() const {
+  std::lock_guard lock(mutex_);
+  return last_error_;
+}
+
+void ArrowFollower::set_error(std::string error) {
+  std::lock_guard lock(mutex_);
+  last_error_ = std::move(error);
+}
+
+void ArrowFollower::loop(const std::string endpoint) {
+  while (running_ && next_index_ < meta_.capacity) {
+    int fd = open_endpoint(endpoint, false);
+    if (fd != -1) {
+      {
+        std::lock_guard lock(mutex_);
+        fd_ = fd;
+      }
+      auto retry = follow(fd);
+      {
+        std::lock_guard lock(mutex_);
+        fd_ = -1;
+        close(fd);
+      }
+      if (!retry) return;
+      status_ = FollowerStatus::CONNECTING;
+    } else {
+      set_error(std::format("failed to connect to the shipper: {}", endpoint));
+    }
+    if (running_ && next_index_ < meta_.capacity) std::this_thread::sleep_for(options_.reconnect_interval);
+  }
+  if (next_index_ == meta_.capacity) status_ = FollowerStatus::COMPLETED;
+}
+
+bool ArrowFollower::follow(int fd) {
+  ReplicationHello hello{.magic = REPLICATION_MAGIC, .fingerprint = fingerprint_, .next_index = next_index_};
+  ReplicationAck ack;
+  if (!send_all(fd, &hello, sizeof(hello)) || !recv_all(fd, &ack, sizeof(ack))) {
+    set_error("connection to the shipper was lost during the handshake");
+    return true;
+  }
+  // the peer is not a shipper, treat it as a broken connection
+  if (ack.magic != REPLICATION_MAGIC) {
+    set_error("invalid handshake from the shipper");
+    return true;
+  }
+  // a different layout never becomes compatible by reconnecting
+  if (!ack.accepted) {
+    set_error("shipper rejected the follower, ArrowMeta is not identical");
+    status_ = FollowerStatus::REJECTED;
+    return false;
+  }
+  status_ = FollowerStatus::FOLLOWING;
+
+  auto bitflag_addr = bitflag_writer_->mmap_addr();
+  while (running_) {
+    uint64_t index;
+    // `stop` shuts the connection down, which is not an error
+    if (!recv_all(fd, &index, sizeof(index))) {
+      if (running_) set_error("connection to the shipper was lost");
+      return true;
+    }
+    if (index >= meta_.capacity) {
+      set_error(std::format("out of range index from the shipper: {}, capacity: {}", index, meta_.capacity));
+      return true;
+    }
+
+    // the layout is identical, so the batch is received straight into its slot
+    for (const auto& [offset, length] : meta_.batch_ranges(index, index + 1)) {
+      if (!recv_all(fd, data_writer_->range(offset, length), length)) {
+        if (running_) set_error(std::format("connection to the shipper was lost while receiving batch: {}", index));
+        return true;
+      }
+    }
+    for (size_t id = 0; id < meta_.writer_count; id++) bitflag::publish(bitflag_addr[index * meta_.writer_count + id]);
+    next_index_.store(index + 1, std::memory_order_release);
+    if (index + 1 == meta_.capacity) return true;
+  }
+  return true;
+}
+
+}  // namespace arrow_mmap
@@ -0,0 +1,154 @@
+#ifndef ARROW_MMAP_ARROW_REPLICATION_HPP
+#define ARROW_MMAP_ARROW_REPLICATION_HPP
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "arrow_mmap/arrow_meta.hpp"
+#include "arrow_mmap/interface.hpp"
+
+namespace arrow_mmap {
+
+/**
+ * Endpoints are either `unix:<path>` for a unix domain socket or `tcp:<host>:<port>`.
+ *
+ * The follower opens the connection with a handshake carrying the layout fingerprint of its ArrowMeta and the first
+ * batch index it misses. The shipper then streams every fully written batch from that index on as a `uint64_t` index
+ * followed by the raw batch bytes, column by column in column-major layout. Both sides must run on the same
+ * architecture, as the bytes are never decoded.
+ */
+struct ReplicationOptions {
+  // how long the shipper waits before polling an incomplete batch again
+  std::chrono::microseconds poll_interval{100};
+  // how long the follower waits before reconnecting to the shipper
+  std::chrono::milliseconds reconnect_interval{100};
+};
+
+/**
+ * @brief ArrowShipper streams newly written batches of the leader store to followers.
+ */
+class ArrowShipper {
+ public:
+  ArrowShipper(const ArrowMeta meta, const IMmapReader* data_reader, const IMmapReader* bitflag_reader,
+               const ReplicationOptions& options = {});
+  ~ArrowShipper();
+
+  // disable copy and assign
+  ArrowShipper(const ArrowShipper&) = delete;
+  ArrowShipper& operator=(const ArrowShipper&) = delete;
+
+  /**
+   * @brief Listen on `endpoint` and serve every follower which connects on its own thread.
+   */
+  void start(const std::string& endpoint);
+  void stop();
+
+ private:
+  void accept_loop();
+  void serve(int fd);
+  bool send_batch(int fd, const size_t index);
+
+  const ArrowMeta meta_;
+  const IMmapReader* data_reader_;
+  const IMmapReader* bitflag_reader_;
+  const ReplicationOptions options_;
+  const uint64_t fingerprint_;
+
+  std::atomic<bool> running_{false};
+  int listen_fd_ = -1;
+  std::thread accept_thread_;
+  std::mutex mutex_;
+  std::vector<int> connections_;
+  std::vector<std::thread> connection_threads_;
+  // the connection threads which returned from `serve` and are ready to be joined
+  std::vector<std::thread::id> finished_threads_;
+};
+
+enum class FollowerStatus {
+  // not started yet, or stopped
+  STOPPED,
+  // connecting to the shipper, or waiting to reconnect after the connection failed
+  CONNECTING,
+  // connected, applying the batches the shipper sends
+  FOLLOWING,
+  // every batch up to the capacity is applied
+  COMPLETED,
+  // the shipper rejected the ArrowMeta of this follower, it gave up
+  REJECTED,
+};
+
+/**
+ * @brief ArrowFollower applies batches received from an ArrowShipper into the follower store.
+ *
+ * The follower store must be created with an identical ArrowMeta. Received bytes are written straight into the data
+ * mapping, then every writer bitflag of the batch is set, so readers of the follower store see complete batches only.
+ */
+class ArrowFollower {
+ public:
+  ArrowFollower(const ArrowMeta meta, const IMmapWriter* data_writer, const IMmapWriter* bitflag_writer,
+                const ReplicationOptions& options = {});
+  ~ArrowFollower();
+
+  // disable copy and assign
+  ArrowFollower(const ArrowFollower&) = delete;
+  ArrowFollower& operator=(const ArrowFollower&) = delete;
+
+  /**
+   * @brief Connect to the shipper at `endpoint` and keep applying batches, reconnecting on errors.
+   *
+   * The follower gives up with `FollowerStatus::REJECTED` if the shipper rejects its ArrowMeta.
+   */
+  void start(const std::string& endpoint);
+  void stop();
+
+  /**
+   * @brief The index of the next batch the follower is waiting for.
+   */
+  size_t next_index() const noexcept { return next_index_.load(std::memory_order_acquire); }
+
+  /**
+   * @brief Whether the follower is connected, reconnecting or has stopped, and why.
+   */
+  FollowerStatus status() const noexcept { return status_.load(std::memory_order_acquire); }
+
+  /**
+   * @brief Why the last connection to the shipper failed or was rejected, empty if none did.
+   */
+  std::string last_error() const;
+
+ private:
+  void loop(const std::string endpoint);
+  /**
+   * @brief Apply batches from a connected shipper until the connection ends.
+   *
+   * A broken connection or a misbehaving peer is recorded in `last_error` and retried after `reconnect_interval`.
+   *
+   * @return false if the shipper rejected this follower, reconnecting would never succeed.
+   */
+  bool follow(int fd);
+  void set_error(std::string error);
+
+  const ArrowMeta meta_;
+  const IMmapWriter* data_writer_;
+  const IMmapWriter* bitflag_writer_;
+  const ReplicationOptions options_;
+  const uint64_t fingerprint_;
+
+  std::atomic<bool> running_{false};
+  std::atomic<size_t> next_index_{0};
+  std::atomic<FollowerStatus> status_{FollowerStatus::STOPPED};
+  // guards `fd_` and `last_error_`
+  mutable std::mutex mutex_;
+  int fd_ = -1;
+  std::string last_error_;
+  std::thread thread_;
+};
+
+}  // namespace arrow_mmap
+
+#endif  // ARROW_MMAP_ARROW_REPLICATION_HPP
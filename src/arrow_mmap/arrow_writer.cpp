@@ -1,15 +1,209 @@
 #include "arrow_mmap/arrow_writer.hpp"
 
+#include <arrow/util/bit_util.h>
 #include <libassert/assert.hpp>
+#include <numeric>
+
+// the AVX2 gathers are built for every x86-64 target and picked at runtime, so they don't need -mavx2
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define ARROW_MMAP_GATHER_AVX2
+#include <immintrin.h>
+#endif
+
+#include <unistd.h>
+
+#include "arrow_mmap/bitflag.hpp"
 
 namespace arrow_mmap {
 
+RowLayout::RowLayout(const std::shared_ptr<arrow::Schema>& schema, const size_t row_size,
+                     const std::vector<RowField>& fields)
+    : schema(schema),
+      row_size(row_size),
+      offsets([&]() {
+        std::vector<size_t> offsets(schema->num_fields(), SIZE_MAX);
+        for (const auto& field : fields) {
+          auto col_id = schema->GetFieldIndex(field.column);
+          ASSERT(col_id != -1, "column not found, column: {}", field.column);
+          ASSERT(offsets[col_id] == SIZE_MAX, "column is mapped more than once, column: {}", field.column);
+          ASSERT(field.offset + field.size <= row_size, "field exceeds row, column: {}, offset: {}, size: {}",
+                 field.column, field.offset, field.size);
+          offsets[col_id] = field.offset;
+        }
+        for (size_t col_id = 0; col_id < offsets.size(); col_id++) {
+          ASSERT(offsets[col_id] != SIZE_MAX, "column is not mapped, column: {}", schema->field(col_id)->name());
+        }
+        return offsets;
+      }()),
+      sizes([&]() {
+        std::vector<size_t> sizes(schema->num_fields());
+        for (const auto& field : fields) {
+          auto col_id = schema->GetFieldIndex(field.column);
+          // the shared dictionary ids of a dictionary column only come from interning its values
+          ASSERT(schema->field(col_id)->type()->id() != arrow::Type::DICTIONARY,
+                 "row layouts don't support dictionary columns, column: {}", field.column);
+          auto byte_width = ArrowMeta::col_size(*schema->field(col_id)->type());
+          ASSERT(byte_width > 0 && field.size == byte_width, "field size: {} != column byte width: {}, column: {}",
+                 field.size, byte_width, field.column);
+          sizes[col_id] = field.size;
+        }
+        return sizes;
+      }()) {}
+
+/**
+ * Copy a strided field of `n` rows into a contiguous column.
+ *
+ * The fixed `N` turns the copy into a single load and store per row. On CPUs with AVX2 the common 4 and 8 byte fields
+ * are gathered 8 and 4 rows at a time instead.
+ */
+template <size_t N>
+static inline void gather(std::byte* dst, const std::byte* src, const size_t stride, const size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    std::memcpy(dst + i * N, src + i * stride, N);
+  }
+}
+
+#ifdef ARROW_MMAP_GATHER_AVX2
+__attribute__((target("avx2"))) static void gather4_avx2(std::byte* dst, const std::byte* src, const size_t stride,
+                                                          const size_t n) {
+  size_t i = 0;
+  if (stride <= INT32_MAX / 8) {
+    const auto vindex =
+        _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(static_cast<int>(stride)));
+    for (; i + 8 <= n; i += 8) {
+      auto values = _mm256_i32gather_epi32(reinterpret_cast<const int*>(src + i * stride), vindex, 1);
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 4), values);
+    }
+  }
+  for (; i < n; i++) {
+    std::memcpy(dst + i * 4, src + i * stride, 4);
+  }
+}
+
+__attribute__((target("avx2"))) static void gather8_avx2(std::byte* dst, const std::byte* src, const size_t stride,
+                                                          const size_t n) {
+  size_t i = 0;
+  if (stride <= INT32_MAX / 4) {
+    const auto vindex = _mm_mullo_epi32(_mm_setr_epi32(0, 1, 2, 3), _mm_set1_epi32(static_cast<int>(stride)));
+    for (; i + 4 <= n; i += 4) {
+      auto values = _mm256_i32gather_epi64(reinterpret_cast<const long long*>(src + i * stride), vindex, 1);
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 8), values);
+    }
+  }
+  for (; i < n; i++) {
+    std::memcpy(dst + i * 8, src + i * stride, 8);
+  }
+}
+
+static const bool HAS_AVX2 = __builtin_cpu_supports("avx2");
+#endif
+
+static void gather(std::byte* dst, const std::byte* src, const size_t size, const size_t stride, const size_t n) {
+  switch (size) {
+    case 1:
+      return gather<1>(dst, src, stride, n);
+    case 2:
+      return gather<2>(dst, src, stride, n);
+    case 4:
+#ifdef ARROW_MMAP_GATHER_AVX2
+      if (HAS_AVX2) return gather4_avx2(dst, src, stride, n);
+#endif
+      return gather<4>(dst, src, stride, n);
+    case 8:
+#ifdef ARROW_MMAP_GATHER_AVX2
+      if (HAS_AVX2) return gather8_avx2(dst, src, stride, n);
+#endif
+      return gather<8>(dst, src, stride, n);
+    case 16:
+      return gather<16>(dst, src, stride, n);
+    default:
+      for (size_t i = 0; i < n; i++) {
+        std::memcpy(dst + i * size, src + i * stride, size);
+      }
+  }
+}
+
+/**
+ * The first value of a fixed-width array, taking the offsets of sliced arrays into account.
+ *
+ * The values of a fixed-size list are contiguous in its child array, so nested lists resolve to their innermost values.
+ */
+static const std::byte* column_values(const arrow::ArrayData& data, const int64_t offset = 0) {
+  if (data.type->id() == arrow::Type::FIXED_SIZE_LIST) {
+    auto list_size = static_cast<const arrow::FixedSizeListType&>(*data.type).list_size();
+    return column_values(*data.child_data[0], (data.offset + offset) * list_size);
+  }
+  return reinterpret_cast<const std::byte*>(data.buffers[1]->data()) +
+         (data.offset + offset) * ArrowMeta::col_size(*data.type);
+}
+
+/**
+ * Write the indices of a dictionary array as ids of the shared dictionary.
+ *
+ * Only the values of the batch-local dictionary are interned, then every index is remapped through that table.
+ */
+template <typename T>
+static void write_dictionary_indices(const arrow::ArrayData& indices, const std::vector<uint32_t>& ids,
+                                     std::byte* dst) {
+  auto local = indices.GetValues<T>(1);
+  auto out = reinterpret_cast<T*>(dst);
+  // the store has no validity bitmap, a null slot may hold any index so it is written as the first id
+  auto validity = indices.GetNullCount() > 0 ? indices.buffers[0]->data() : nullptr;
+  for (int64_t row = 0; row < indices.length; row++) {
+    if (validity && !arrow::bit_util::GetBit(validity, indices.offset + row)) {
+      out[row] = 0;
+      continue;
+    }
+    auto index = static_cast<uint64_t>(local[row]);
+    ASSERT(index < ids.size(), "dictionary index out of range, index: {}, dictionary length: {}", index, ids.size());
+    out[row] = static_cast<T>(ids[index]);
+  }
+}
+
+static void write_dictionary_array(ArrowDictionary* dictionary, const arrow::DictionaryArray& array, std::byte* dst) {
+  const auto& values = static_cast<const arrow::BinaryArray&>(*array.dictionary());
+  std::vector<uint32_t> ids(values.length());
+  for (int64_t i = 0; i < values.length(); i++) {
+    ids[i] = dictionary->intern(values.GetView(i));
+  }
+
+  const auto& indices = *array.indices()->data();
+  auto max_id = ids.empty() ? 0 : *std::max_element(ids.begin(), ids.end());
+  auto check = [&]<typename T>() {
+    ASSERT(max_id <= static_cast<uint64_t>(std::numeric_limits<T>::max()),
+           "dictionary id overflows index type, id: {}, index type: {}", max_id, indices.type->ToString());
+    write_dictionary_indices<T>(indices, ids, dst);
+  };
+  switch (indices.type->id()) {
+    case arrow::Type::INT8:
+      return check.template operator()<int8_t>();
+    case arrow::Type::UINT8:
+      return check.template operator()<uint8_t>();
+    case arrow::Type::INT16:
+      return check.template operator()<int16_t>();
+    case arrow::Type::UINT16:
+      return check.template operator()<uint16_t>();
+    case arrow::Type::INT32:
+      return check.template operator()<int32_t>();
+    case arrow::Type::UINT32:
+      return check.template operator()<uint32_t>();
+    case arrow::Type::INT64:
+      return check.template operator()<int64_t>();
+    case arrow::Type::UINT64:
+      return check.template operator()<uint64_t>();
+    default:
+      PANIC("unsupported dictionary index type");
+  }
+}
+
 ArrowWriter::ArrowWriter(const size_t id, const ArrowMeta meta, const IMmapWriter* data_writer,
-                         const IMmapWriter* bitflag_writer)
+                         const IMmapWriter* bitflag_writer, ArrowDictionary* dictionary,
+                         const ArrowWriterOptions& options)
     : id(id),
       meta_(meta),
       data_writer_(data_writer),
       bitflag_writer_(bitflag_writer),
+      dictionary_(dictionary),
       write_rows([id, meta]() {
         if (id < meta.writer_count - 1) {
           return meta.array_length / meta.writer_count;
@@ -17,13 +211,7 @@ ArrowWriter::ArrowWriter(const size_t id, const ArrowMeta meta, const IMmapWrite
           return meta.array_length - meta.array_length / meta.writer_count * (meta.writer_count - 1);
         }
       }()),
-      col_sizes_([&]() {
-        std::vector<size_t> col_sizes;
-        for (const auto& field : meta.schema->fields()) {
-          col_sizes.push_back(field->type()->byte_width());
-        }
-        return col_sizes;
-      }()),
+      col_sizes_(meta.col_sizes()),
       col_array_sizes_([&]() {
         std::vector<size_t> col_array_sizes;
         // Because except for the last writer, the num_rows of other writers is the same
@@ -33,15 +221,15 @@ ArrowWriter::ArrowWriter(const size_t id, const ArrowMeta meta, const IMmapWrite
         }
         return col_array_sizes;
       }()),
-      col_array_offsets_([&]() {
-        std::vector<size_t> col_array_offsets;
-        for (size_t i = 0; i < col_sizes_.size(); i++) {
-          col_array_offsets.push_back(std::accumulate(col_sizes_.begin(), col_sizes_.begin() + i, 0) *
-                                      meta_.array_length);
-        }
-        return col_array_offsets;
-      }()),
-      batch_size_(std::accumulate(col_sizes_.begin(), col_sizes_.end(), 0) * meta_.array_length) {}
+      col_array_offsets_(meta.col_offsets()),
+      col_array_strides_(meta.col_strides()),
+      flush_policy_(options.flush.policy),
+      flusher_(flush_policy_ == FlushPolicy::ASYNC || flush_policy_ == FlushPolicy::GROUP
+                   ? std::make_unique<ArrowFlusher>(id, meta, data_writer, bitflag_writer, options.flush)
+                   : nullptr),
+      copier_(options.copy),
+      write_bytes_(std::accumulate(col_sizes_.begin(), col_sizes_.end(), size_t(0)) * write_rows),
+      page_size_(sysconf(_SC_PAGESIZE)) {}
 
 bool ArrowWriter::write(const std::shared_ptr<arrow::RecordBatch>& batch) {
   auto ret = write(batch, index_);
@@ -54,18 +242,114 @@ bool ArrowWriter::write(const std::shared_ptr<arrow::RecordBatch>& batch, const
   ASSERT(batch->schema()->Equals(meta_.schema), "batch schema is not equal to meta schema");
   ASSERT(batch->num_rows() == write_rows, "batch num_rows: {} != write_rows: {}", batch->num_rows(), write_rows);
 
-  auto target_batch_addr = data_writer_->mmap_addr() + index * batch_size_;
+  auto start = metrics::now();
+  auto faults = metrics::faults();
+  slices_.clear();
   for (size_t col_id = 0; col_id < col_sizes_.size(); col_id++) {
-    auto col_array_size = col_array_sizes_[col_id];
-    auto col_addr = target_batch_addr + col_array_offsets_[col_id];
-    auto col_writer_addr = col_addr + id * col_array_size;
-    auto col_array_data = batch->column(col_id)->data()->buffers[1];
-    std::memcpy(col_writer_addr, reinterpret_cast<std::byte*>(col_array_data->address()), col_array_data->size());
+    auto col_writer_addr = this->col_writer_addr(col_id, index);
+    if (batch->column(col_id)->type_id() == arrow::Type::DICTIONARY) {
+      ASSERT(dictionary_ != nullptr, "writer has no dictionary");
+      write_dictionary_array(dictionary_, static_cast<const arrow::DictionaryArray&>(*batch->column(col_id)),
+                             col_writer_addr);
+      continue;
+    }
+    slices_.push_back(
+        {col_writer_addr, column_values(*batch->column(col_id)->data()), col_sizes_[col_id] * write_rows});
   }
+  copier_.copy(slices_);
+  record_copy(start, faults);
 
-  // mark the index of current writer is written
-  auto bitflag_addr = bitflag_writer_->mmap_addr();
-  bitflag_addr[index * meta_.writer_count + id] = std::byte(0xff);
+  publish(index);
   return true;
 }
+
+bool ArrowWriter::write(const std::byte* rows, const size_t num_rows, const RowLayout& layout) {
+  auto ret = write(rows, num_rows, layout, index_);
+  if (ret) index_++;
+  return ret;
+}
+
+bool ArrowWriter::write(const std::byte* rows, const size_t num_rows, const RowLayout& layout, const size_t index) {
+  ASSERT(index < meta_.capacity, "index out of range, index: {}, capacity: {}", index, meta_.capacity);
+  // the field sizes were only checked against the layout's schema, which must be the one this writer writes
+  ASSERT(layout.schema == meta_.schema || layout.schema->Equals(*meta_.schema),
+         "layout schema is not equal to meta schema");
+  ASSERT(num_rows == write_rows, "num_rows: {} != write_rows: {}", num_rows, write_rows);
+
+  // transpose about 32KiB of rows at a time, so the rows stay in L1 while they are scattered to every column
+  const size_t block_rows = std::max<size_t>(16, (32 << 10) / layout.row_size);
+
+  auto start = metrics::now();
+  auto faults = metrics::faults();
+  std::vector<std::byte*> col_writer_addrs(col_sizes_.size());
+  for (size_t col_id = 0; col_id < col_sizes_.size(); col_id++) {
+    col_writer_addrs[col_id] = col_writer_addr(col_id, index);
+  }
+  for (size_t row = 0; row < num_rows; row += block_rows) {
+    auto n = std::min(block_rows, num_rows - row);
+    auto block = rows + row * layout.row_size;
+    for (size_t col_id = 0; col_id < col_sizes_.size(); col_id++) {
+      auto col_writer_addr = col_writer_addrs[col_id];
+      auto size = layout.sizes[col_id];
+      gather(col_writer_addr + row * size, block + layout.offsets[col_id], size, layout.row_size, n);
+    }
+  }
+  record_copy(start, faults);
+
+  publish(index);
+  return true;
+}
+
+std::byte* ArrowWriter::col_writer_addr(const size_t col_id, const size_t index) const {
+  auto offset = col_array_offsets_[col_id] + index * col_array_strides_[col_id] + id * col_array_sizes_[col_id];
+  return data_writer_->range(offset, col_sizes_[col_id] * write_rows);
+}
+
+void ArrowWriter::record_copy(const uint64_t start, const metrics::Faults& faults) noexcept {
+  metrics::add(metrics_.batches, 1);
+  metrics::add(metrics_.bytes, write_bytes_);
+  metrics::add(metrics_.copy_ns, metrics::now() - start);
+  auto end_faults = metrics::faults();
+  metrics::add(metrics_.minor_faults, end_faults.minor - faults.minor);
+  metrics::add(metrics_.major_faults, end_faults.major - faults.major);
+}
+
+void ArrowWriter::publish(const size_t index) {
+  auto start = metrics::now();
+  do_publish(index);
+  metrics::add(metrics_.publish_ns, metrics::now() - start);
+}
+
+void ArrowWriter::do_publish(const size_t index) {
+  switch (flush_policy_) {
+    case FlushPolicy::ASYNC:
+    case FlushPolicy::GROUP:
+      // the flusher marks the index as written once the data is on disk
+      flusher_->push(index);
+      return;
+    case FlushPolicy::SYNC:
+      // only this writer's slices, the other writers sync their own
+      for (const auto& [offset, length] : meta_.writer_ranges(id, index, index + 1, page_size_)) {
+        data_writer_->sync(offset, length);
+      }
+      break;
+    case FlushPolicy::NONE:
+      break;
+  }
+
+  // mark the index of current writer is written
+  auto bitflag_offset = index * meta_.writer_count + id;
+  bitflag::publish(bitflag_writer_->mmap_addr()[bitflag_offset]);
+  if (flush_policy_ == FlushPolicy::SYNC) {
+    bitflag_writer_->sync(bitflag_offset, 1);
+  }
+  ARROW_MMAP_PROBE2(publish, id, index);
+}
+
+void ArrowWriter::flush() {
+  if (!flusher_) return;
+  auto start = metrics::now();
+  flusher_->flush();
+  metrics::add(metrics_.flush_ns, metrics::now() - start);
+}
 }  // namespace arrow_mmap
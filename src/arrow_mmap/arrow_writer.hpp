@@ -3,21 +3,98 @@
 #pragma once
 
 #include <arrow/api.h>
+#include <libassert/assert.hpp>
+#include <span>
 
+#include "arrow_mmap/arrow_copier.hpp"
+#include "arrow_mmap/arrow_dictionary.hpp"
+#include "arrow_mmap/arrow_flusher.hpp"
 #include "arrow_mmap/arrow_meta.hpp"
 #include "arrow_mmap/interface.hpp"
+#include "arrow_mmap/metrics.hpp"
 
 namespace arrow_mmap {
 
+struct ArrowWriterOptions {
+  FlushOptions flush = {};
+  CopyOptions copy = {};
+};
+
+struct RowField {
+  // the column name in `ArrowMeta::schema`
+  std::string column;
+  // the byte offset of the field inside a row
+  size_t offset;
+  // the byte size of the field, must be equal to the byte width of the column
+  size_t size;
+};
+
+/**
+ * @brief RowLayout maps the fields of a fixed-layout row onto the columns of a schema.
+ *
+ * The mapping is validated once at construction, every column of the schema must be mapped by exactly one field.
+ * Dictionary columns are not supported, their values have to be interned, so write them as a RecordBatch.
+ */
+class RowLayout {
+ public:
+  RowLayout(const std::shared_ptr<arrow::Schema>& schema, const size_t row_size, const std::vector<RowField>& fields);
+
+  template <typename Row>
+  static RowLayout of(const std::shared_ptr<arrow::Schema>& schema, const std::vector<RowField>& fields) {
+    static_assert(std::is_trivially_copyable_v<Row>, "Row must be trivially copyable");
+    return RowLayout(schema, sizeof(Row), fields);
+  }
+
+  // the schema the fields are validated against
+  const std::shared_ptr<arrow::Schema> schema;
+  const size_t row_size;
+  // indexed by column id
+  const std::vector<size_t> offsets;
+  const std::vector<size_t> sizes;
+};
+
 class ArrowWriter {
  public:
-  ArrowWriter(const size_t id, const ArrowMeta meta, const IMmapWriter* data_writer, const IMmapWriter* bitflag_writer);
+  /**
+   * @param dictionary The shared dictionary, required when the schema has dictionary columns.
+   */
+  ArrowWriter(const size_t id, const ArrowMeta meta, const IMmapWriter* data_writer, const IMmapWriter* bitflag_writer,
+              ArrowDictionary* dictionary = nullptr, const ArrowWriterOptions& options = {});
 
   bool write(const std::shared_ptr<arrow::RecordBatch>& batch);
   bool write(const std::shared_ptr<arrow::RecordBatch>& batch, const size_t index);
 
+  /**
+   * @brief Write `write_rows` packed rows, scattering every field directly into its column slice.
+   *
+   * This skips building a RecordBatch: rows are transposed block by block, so a block of rows stays in cache while
+   * it is scattered to every column.
+   *
+   * @param rows The first byte of `num_rows` rows of `layout.row_size` bytes each.
+   */
+  bool write(const std::byte* rows, const size_t num_rows, const RowLayout& layout);
+  bool write(const std::byte* rows, const size_t num_rows, const RowLayout& layout, const size_t index);
+
+  template <typename Row>
+  bool write(std::span<const Row> rows, const RowLayout& layout) {
+    ASSERT(sizeof(Row) == layout.row_size, "row size: {} != layout row_size: {}", sizeof(Row), layout.row_size);
+    return write(reinterpret_cast<const std::byte*>(rows.data()), rows.size(), layout);
+  }
+
+  /**
+   * @brief Block until every written batch is flushed and marked as written.
+   *
+   * Only has effect for `FlushPolicy::ASYNC` and `FlushPolicy::GROUP`, the other policies publish in `write`.
+   */
+  void flush();
+
   const size_t current_index() const noexcept { return index_; }
 
+  /**
+   * @brief A snapshot of the counters, safe to take from any thread.
+   */
+  WriterMetrics metrics() const noexcept { return metrics::snapshot(metrics_); }
+
   const size_t write_rows;
   const size_t id;
 
@@ -26,10 +103,27 @@ class ArrowWriter {
   const ArrowMeta meta_;
   const IMmapWriter* data_writer_;
   const IMmapWriter* bitflag_writer_;
+  ArrowDictionary* dictionary_;
   const std::vector<size_t> col_sizes_;
   const std::vector<size_t> col_array_sizes_;
   const std::vector<size_t> col_array_offsets_;
-  const size_t batch_size_;
+  const std::vector<size_t> col_array_strides_;
+  const FlushPolicy flush_policy_;
+  std::unique_ptr<ArrowFlusher> flusher_;
+  ArrowCopier copier_;
+  // the column slices of the batch being written, reused across writes
+  std::vector<CopySlice> slices_;
+  // the bytes of this writer's slices of one batch
+  const size_t write_bytes_;
+  const size_t page_size_;
+  WriterMetrics metrics_;
+
+  // the address of this writer's slice of a column of batch `index`
+  std::byte* col_writer_addr(const size_t col_id, const size_t index) const;
+  // count a batch copied since `start`, which took the faults since `faults`
+  void record_copy(const uint64_t start, const metrics::Faults& faults) noexcept;
+  void publish(const size_t index);
+  void do_publish(const size_t index);
 };
 
 }  // namespace arrow_mmap
@@ -0,0 +1,33 @@
+#ifndef ARROW_MMAP_BITFLAG_HPP
+#define ARROW_MMAP_BITFLAG_HPP
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+namespace arrow_mmap {
+namespace bitflag {
+
+// the value of a bitflag once its writer's slices of the batch are written
+inline constexpr std::byte WRITTEN{0xff};
+
+/**
+ * Publish a batch of one writer.
+ *
+ * A release store, so a reader which sees the flag with `written` also sees the data and the dictionary entries
+ * written before it.
+ */
+inline void publish(std::byte& flag) noexcept { std::atomic_ref(flag).store(WRITTEN, std::memory_order_release); }
+
+// whether all `count` flags from `flags` are published, with acquire loads pairing with `publish`
+inline bool written(const std::byte* flags, const size_t count) noexcept {
+  for (size_t i = 0; i < count; i++) {
+    if (std::atomic_ref(const_cast<std::byte&>(flags[i])).load(std::memory_order_acquire) != WRITTEN) return false;
+  }
+  return true;
+}
+
+}  // namespace bitflag
+}  // namespace arrow_mmap
+
+#endif  // ARROW_MMAP_BITFLAG_HPP
@@ -10,12 +10,18 @@ class IMmapReader {
  public:
   virtual size_t length() const = 0;
   virtual const std::byte* mmap_addr() const = 0;
+  // the address of [offset, offset + length), making sure the windows covering it are mapped by a windowed mapping
+  virtual const std::byte* range(size_t offset, size_t length) const = 0;
 };
 
 class IMmapWriter {
  public:
   virtual size_t length() const = 0;
   virtual std::byte* mmap_addr() const = 0;
+  // the address of [offset, offset + length), making sure the windows covering it are mapped by a windowed mapping
+  virtual std::byte* range(size_t offset, size_t length) const = 0;
+  // flush [offset, offset + length) to the backing store and wait until it is done
+  virtual void sync(size_t offset, size_t length) const = 0;
 };
 
 }  // namespace arrow_mmap
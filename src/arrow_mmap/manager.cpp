@@ -1,44 +1,190 @@
 #include "arrow_mmap/manager.hpp"
 
+#include <atomic>
+#include <climits>
 #include <cstring>
+#include <deque>
 #include <filesystem>
 #include <libassert/assert.hpp>
+#include <mutex>
 
 #include <fcntl.h>
 #include <sys/mman.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
 namespace arrow_mmap {
 
+// the most fds `MmapManager::send` passes in one message
+static const size_t MAX_SENT_FDS = 16;
+
+// the name of the shm object of `file`, e.g. `/tmp/store/data.mmap` is `/arrow_mmap.tmp.store.data.mmap`
+static std::string get_shm_name(const std::string& file) {
+  auto path = std::filesystem::absolute(file).lexically_normal().string();
+  std::replace(path.begin(), path.end(), '/', '.');
+  auto name = "/arrow_mmap" + path;
+  ASSERT(name.size() <= NAME_MAX, std::format("shm name is too long, file: {}", file));
+  return name;
+}
+
 size_t get_fd_length(int fd) {
   struct stat st;
   fstat(fd, &st);
   return st.st_size;
 }
 
+/**
+ * MmapWindows keeps the windows of a mapping which were accessed most recently populated, in LRU order.
+ *
+ * Populating a window applies the madvise of the mapping to it, and `MAP_POPULATE` of the mapping turns into
+ * `MADV_POPULATE_READ` of the window, or `MADV_POPULATE_WRITE` for a private writable mapping, the same faults
+ * `MAP_POPULATE` takes. Dropping a window maps the same file range over it with `MAP_FIXED`, which frees its page
+ * tables while the address stays mapped to the same data.
+ */
+class MmapWindows {
+ public:
+  MmapWindows(std::byte* addr, size_t length, int fd, int prot, int flags, int advice, const WindowOptions& options)
+      : addr_(addr),
+        length_(length),
+        fd_(fd),
+        prot_(prot),
+        flags_(flags & ~MAP_POPULATE),
+        populate_(flags & MAP_POPULATE),
+        advice_(advice),
+        window_size_([&]() {
+          static const size_t page_size = sysconf(_SC_PAGESIZE);
+          return (options.size + page_size - 1) / page_size * page_size;
+        }()),
+        cache_(std::max<size_t>(options.cache, 1)) {}
+
+  void touch(size_t offset, size_t length) {
+    if (length == 0) return;
+    auto first = offset / window_size_;
+    auto last = (offset + length - 1) / window_size_;
+    // sequential cursors stay inside the last window most of the time
+    if (first == last && first == last_.load(std::memory_order_relaxed)) return;
+
+    std::lock_guard lock(mutex_);
+    for (auto window = first; window <= last; window++) {
+      auto it = std::find(windows_.begin(), windows_.end(), window);
+      if (it != windows_.end()) {
+        windows_.erase(it);
+      } else {
+        populate(window);
+      }
+      windows_.push_back(window);
+    }
+    // never drop a window of the current range, even if it spans more windows than the cache holds
+    while (windows_.size() > std::max(cache_, last - first + 1)) {
+      drop(windows_.front());
+      windows_.pop_front();
+    }
+    last_.store(last, std::memory_order_relaxed);
+  }
+
+ private:
+  void populate(size_t window) {
+    auto offset = window * window_size_;
+    auto length = std::min(window_size_, length_ - offset);
+    ASSERT(-1 != madvise(addr_ + offset, length, advice_),
+           std::format("failed to madvise window, offset: {}, error: {}", offset, strerror(errno)));
+    if (populate_) {
+#ifdef MADV_POPULATE_READ
+      // like MAP_POPULATE, only a private writable mapping is write faulted, write faults on a shared file mapping
+      // would dirty every page of the window and get all of it written back
+      auto populate_advice =
+          (prot_ & PROT_WRITE) && (flags_ & MAP_PRIVATE) ? MADV_POPULATE_WRITE : MADV_POPULATE_READ;
+#else
+      auto populate_advice = MADV_WILLNEED;
+#endif
+      auto ret = madvise(addr_ + offset, length, populate_advice);
+      // MADV_POPULATE_READ and MADV_POPULATE_WRITE are not supported before linux 5.14
+      if (ret == -1 && errno == EINVAL && populate_advice != MADV_WILLNEED) {
+        ret = madvise(addr_ + offset, length, MADV_WILLNEED);
+      }
+      ASSERT(-1 != ret, std::format("failed to populate window, offset: {}, error: {}", offset, strerror(errno)));
+    }
+  }
+
+  void drop(size_t window) {
+    auto offset = window * window_size_;
+    auto length = std::min(window_size_, length_ - offset);
+    auto addr = mmap(addr_ + offset, length, prot_, flags_ | MAP_FIXED, fd_, offset);
+    ASSERT(addr == addr_ + offset,
+           std::format("failed to remap window, offset: {}, error: {}", offset, strerror(errno)));
+  }
+
+  std::byte* const addr_;
+  const size_t length_;
+  const int fd_;
+  const int prot_;
+  const int flags_;
+  const bool populate_;
+  const int advice_;
+  const size_t window_size_;
+  const size_t cache_;
+
+  std::mutex mutex_;
+  std::deque<size_t> windows_;
+  std::atomic<size_t> last_ = SIZE_MAX;
+};
+
 class MmapReader : public IMmapReader {
  public:
-  MmapReader(std::byte* addr, size_t length) : addr_(addr), length_(length) {}
+  MmapReader(std::byte* addr, size_t length, MmapWindows* windows = nullptr, size_t windows_offset = 0)
+      : addr_(addr), length_(length), windows_(windows), windows_offset_(windows_offset) {}
 
   inline size_t length() const override { return length_; }
   inline const std::byte* mmap_addr() const override { return addr_; }
 
+  inline const std::byte* range(size_t offset, size_t length) const override {
+    if (windows_) windows_->touch(windows_offset_ + offset, length);
+    return addr_ + offset;
+  }
+
+  // the windows of the whole file, and the offset of this mapping inside it
+  inline MmapWindows* windows() const noexcept { return windows_; }
+  inline size_t windows_offset() const noexcept { return windows_offset_; }
+
  private:
   const size_t length_;
   std::byte* addr_;
+  MmapWindows* windows_;
+  const size_t windows_offset_;
 };
 
 class MmapWriter : public IMmapWriter {
  public:
-  MmapWriter(std::byte* addr, size_t length) : addr_(addr), length_(length) {}
+  MmapWriter(std::byte* addr, size_t length, MmapWindows* windows = nullptr, size_t windows_offset = 0)
+      : addr_(addr), length_(length), windows_(windows), windows_offset_(windows_offset) {}
 
   inline size_t length() const override { return length_; }
   inline std::byte* mmap_addr() const override { return addr_; }
 
+  inline std::byte* range(size_t offset, size_t length) const override {
+    if (windows_) windows_->touch(windows_offset_ + offset, length);
+    return addr_ + offset;
+  }
+
+  void sync(size_t offset, size_t length) const override {
+    // msync requires a page aligned address, and a slice may start in the middle of a page
+    static const uintptr_t page_size = sysconf(_SC_PAGESIZE);
+    auto end = reinterpret_cast<uintptr_t>(addr_) + std::min(offset + length, length_);
+    auto begin = (reinterpret_cast<uintptr_t>(addr_) + offset) / page_size * page_size;
+    ASSERT(-1 != msync(reinterpret_cast<void*>(begin), end - begin, MS_SYNC),
+           std::format("writer failed to msync, offset: {}, length: {}, error: {}", offset, length, strerror(errno)));
+  }
+
+  // the windows of the whole file, and the offset of this mapping inside it
+  inline MmapWindows* windows() const noexcept { return windows_; }
+  inline size_t windows_offset() const noexcept { return windows_offset_; }
+
  private:
   const size_t length_;
   std::byte* addr_;
+  MmapWindows* windows_;
+  const size_t windows_offset_;
 };
 
 class MmapManager::Impl {
@@ -46,24 +192,61 @@ class MmapManager::Impl {
   Impl(const std::string& file, int file_fd, size_t file_length, const MmapManagerOptions& options)
       : file_(file), file_fd_(file_fd), file_length_(file_length), options_(options) {}
 
+  // a slice shares the mappings of `parent`
+  Impl(std::shared_ptr<Impl> parent, size_t offset, size_t length)
+      : file_(parent->file_),
+        file_fd_(-1),
+        file_length_(length),
+        options_(parent->options_),
+        parent_(std::move(parent)),
+        offset_(offset) {}
+
+  ~Impl() {
+    if (reader_) {
+      if (!parent_) munmap(const_cast<std::byte*>(reader_->mmap_addr()), file_length_);
+      delete reader_;
+    }
+    if (writer_) {
+      if (!parent_) munmap(writer_->mmap_addr(), file_length_);
+      delete writer_;
+    }
+    if (file_fd_ != -1) close(file_fd_);
+  }
+
   MmapReader* reader() {
     if (nullptr == reader_) {
-      auto addr = mmap(NULL, file_length_, PROT_READ, MAP_PRIVATE | options_.reader_flags, file_fd_, 0);
-      ASSERT(addr != MAP_FAILED, std::format("reader failed to mmap file: {}, error: {}", file_, strerror(errno)));
-      ASSERT(-1 != madvise(addr, file_length_, options_.madvise),
-             std::format("reader failed to madvise file: {}, error: {}", file_, strerror(errno)));
-      reader_ = new MmapReader(static_cast<std::byte*>(addr), file_length_);
+      if (parent_) {
+        auto parent = parent_->reader();
+        reader_ = new MmapReader(const_cast<std::byte*>(parent->mmap_addr()) + offset_, file_length_,
+                                 parent->windows(), parent->windows_offset() + offset_);
+        return reader_;
+      }
+      auto addr = map(PROT_READ, MAP_PRIVATE | options_.reader_flags, "reader");
+      if (windowed()) {
+        reader_windows_ = std::make_unique<MmapWindows>(addr, file_length_, file_fd_, PROT_READ,
+                                                        MAP_PRIVATE | options_.reader_flags, options_.madvise,
+                                                        options_.window);
+      }
+      reader_ = new MmapReader(addr, file_length_, reader_windows_.get());
     }
     return reader_;
   }
 
   MmapWriter* writer() {
     if (nullptr == writer_) {
-      auto addr = mmap(NULL, file_length_, PROT_READ | PROT_WRITE, MAP_SHARED | options_.writer_flags, file_fd_, 0);
-      ASSERT(addr != MAP_FAILED, std::format("writer failed to mmap file: {}, error: {}", file_, strerror(errno)));
-      ASSERT(-1 != madvise(addr, file_length_, options_.madvise),
-             std::format("writer failed to madvise file: {}, error: {}", file_, strerror(errno)));
-      writer_ = new MmapWriter(static_cast<std::byte*>(addr), file_length_);
+      if (parent_) {
+        auto parent = parent_->writer();
+        writer_ = new MmapWriter(parent->mmap_addr() + offset_, file_length_, parent->windows(),
+                                 parent->windows_offset() + offset_);
+        return writer_;
+      }
+      auto addr = map(PROT_READ | PROT_WRITE, MAP_SHARED | options_.writer_flags, "writer");
+      if (windowed()) {
+        writer_windows_ = std::make_unique<MmapWindows>(addr, file_length_, file_fd_, PROT_READ | PROT_WRITE,
+                                                        MAP_SHARED | options_.writer_flags, options_.madvise,
+                                                        options_.window);
+      }
+      writer_ = new MmapWriter(addr, file_length_, writer_windows_.get());
     }
     return writer_;
   }
@@ -71,55 +254,192 @@ class MmapManager::Impl {
  private:
   friend class MmapManager;
 
+  bool windowed() const noexcept { return options_.window.size > 0; }
+
+  // a windowed mapping only reserves the file here, its windows are populated and advised by `MmapWindows`
+  std::byte* map(int prot, int flags, const char* role) {
+    if (windowed()) flags &= ~MAP_POPULATE;
+    auto addr = mmap(NULL, file_length_, prot, flags, file_fd_, 0);
+    ASSERT(addr != MAP_FAILED, std::format("{} failed to mmap file: {}, error: {}", role, file_, strerror(errno)));
+    if (!windowed()) {
+      ASSERT(-1 != madvise(addr, file_length_, options_.madvise),
+             std::format("{} failed to madvise file: {}, error: {}", role, file_, strerror(errno)));
+    }
+    return static_cast<std::byte*>(addr);
+  }
+
   const std::string file_;
   const MmapManagerOptions options_;
-  const int file_length_;
+  const size_t file_length_;
   const int file_fd_;
+  const std::shared_ptr<Impl> parent_;
+  const size_t offset_ = 0;
 
   MmapReader* reader_ = nullptr;
   MmapWriter* writer_ = nullptr;
+  std::unique_ptr<MmapWindows> reader_windows_;
+  std::unique_ptr<MmapWindows> writer_windows_;
 };
 
 MmapManager::MmapManager(const std::string& file, const MmapManagerOptions& options) {
+  ASSERT(options.backend != MmapBackend::MEMFD,
+         std::format("a memfd can't be opened by name, receive it from its owner, file: {}", file));
+
   // try to open file
-  int fd = open(file.c_str(), O_RDWR, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+  int fd = options.backend == MmapBackend::SHM
+               ? shm_open(get_shm_name(file).c_str(), O_RDWR, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH)
+               : open(file.c_str(), O_RDWR, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
   ASSERT(fd != -1, std::format("failed to open file: {}, error: {}", file, strerror(errno)));
 
   size_t length = get_fd_length(fd);
   ASSERT(length > 0, std::format("file {} is empty", file));
-  impl_ = new MmapManager::Impl(file, fd, length, options);
+  impl_ = std::make_shared<MmapManager::Impl>(file, fd, length, options);
 }
 
 MmapManager MmapManager::create(const std::string& file, size_t length, const MmapManagerCreateOptions& options) {
   ASSERT(length > 0, std::format("can't create mmap file with 0 length, file: {}", file));
 
-  std::filesystem::path file_dir = std::filesystem::path(std::filesystem::absolute(file)).parent_path();
-  if (!std::filesystem::exists(file_dir)) {
-    std::filesystem::create_directories(file_dir);
+  int fd = -1;
+  switch (options.backend) {
+    case MmapBackend::FILE: {
+      std::filesystem::path file_dir = std::filesystem::path(std::filesystem::absolute(file)).parent_path();
+      if (!std::filesystem::exists(file_dir)) {
+        std::filesystem::create_directories(file_dir);
+      }
+      fd = open(file.c_str(), O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+      break;
+    }
+    case MmapBackend::SHM:
+      fd = shm_open(get_shm_name(file).c_str(), O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+      break;
+    case MmapBackend::MEMFD:
+      // the name only shows up in /proc/<pid>/fd
+      fd = memfd_create(std::filesystem::path(file).filename().c_str(), MFD_CLOEXEC);
+      break;
   }
-
-  int fd = open(file.c_str(), O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
   ASSERT(fd != -1, std::format("failed to open file: {}, error: {}", file, strerror(errno)));
 
   ASSERT(ftruncate(fd, length) != -1, std::format("failed to truncate file: {}, error: {}", file, strerror(errno)));
 
-  // filling the file content with `options.fill_with`
-  void* addr = mmap(nullptr, length, PROT_WRITE, MAP_SHARED, fd, 0);
-  ASSERT(addr != MAP_FAILED, std::format("failed to mmap file: {}, error: {}", file, strerror(errno)));
-  std::memset(addr, static_cast<int>(options.fill_with), length);
-  munmap(addr, length);
+  // filling the file content with `options.fill_with`, which also allocates the blocks and warms the page cache
+  ASSERT(!options.sparse || options.fill_with == std::byte(0x00), "a sparse file can only be filled with 0");
+  if (!options.sparse) {
+    void* addr = mmap(nullptr, length, PROT_WRITE, MAP_SHARED, fd, 0);
+    ASSERT(addr != MAP_FAILED, std::format("failed to mmap file: {}, error: {}", file, strerror(errno)));
+    std::memset(addr, static_cast<int>(options.fill_with), length);
+    munmap(addr, length);
+  }
 
-  return MmapManager(new MmapManager::Impl(
+  return MmapManager(std::make_shared<MmapManager::Impl>(
       file, fd, length,
-      {.reader_flags = options.reader_flags, .writer_flags = options.writer_flags, .madvise = options.madvise}));
+      MmapManagerOptions{
+          .reader_flags = options.reader_flags,
+          .writer_flags = options.writer_flags,
+          .madvise = options.madvise,
+          .window = options.window,
+          .backend = options.backend,
+      }));
+}
+
+MmapManager::~MmapManager() = default;
+
+bool MmapManager::exists(const std::string& file, const MmapBackend backend) noexcept {
+  switch (backend) {
+    case MmapBackend::FILE:
+      return std::filesystem::exists(file);
+    case MmapBackend::SHM: {
+      int fd = shm_open(get_shm_name(file).c_str(), O_RDONLY, 0);
+      if (fd == -1) return false;
+      // a shm object is empty until its creator truncated it to its length
+      auto length = get_fd_length(fd);
+      close(fd);
+      return length > 0;
+    }
+    case MmapBackend::MEMFD:
+      return false;
+  }
+  return false;
 }
 
-MmapManager::~MmapManager() {
-  if (impl_) {
-    delete impl_;
+void MmapManager::remove(const std::string& file, const MmapBackend backend) {
+  switch (backend) {
+    case MmapBackend::FILE:
+      std::filesystem::remove(file);
+      break;
+    case MmapBackend::SHM:
+      ASSERT(-1 != shm_unlink(get_shm_name(file).c_str()) || errno == ENOENT,
+             std::format("failed to remove shm object of file: {}, error: {}", file, strerror(errno)));
+      break;
+    case MmapBackend::MEMFD:
+      // a memfd is removed with its last fd
+      break;
   }
 }
 
+void MmapManager::send(int socket, const std::vector<const MmapManager*>& managers) {
+  ASSERT(!managers.empty() && managers.size() <= MAX_SENT_FDS, "can only send 1 to {} managers, managers: {}",
+         MAX_SENT_FDS, managers.size());
+  std::vector<int> fds;
+  for (const auto& manager : managers) {
+    ASSERT(manager->impl_->file_fd_ != -1, "a slice can't be sent, send the manager it is sliced from");
+    fds.push_back(manager->impl_->file_fd_);
+  }
+
+  // the fds travel as SCM_RIGHTS ancillary data of a message carrying their count
+  uint64_t count = fds.size();
+  iovec iov{.iov_base = &count, .iov_len = sizeof(count)};
+  std::vector<char> control(CMSG_SPACE(sizeof(int) * fds.size()));
+  msghdr msg{};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.data();
+  msg.msg_controllen = control.size();
+  auto cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+  std::memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * fds.size());
+  ASSERT(static_cast<ssize_t>(sizeof(count)) == sendmsg(socket, &msg, MSG_NOSIGNAL),
+         std::format("failed to send fds, error: {}", strerror(errno)));
+}
+
+std::vector<MmapManager> MmapManager::receive(int socket, const MmapManagerOptions& options) {
+  uint64_t count = 0;
+  iovec iov{.iov_base = &count, .iov_len = sizeof(count)};
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * MAX_SENT_FDS)];
+  msghdr msg{};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  ASSERT(static_cast<ssize_t>(sizeof(count)) == recvmsg(socket, &msg, MSG_CMSG_CLOEXEC),
+         std::format("failed to receive fds, error: {}", strerror(errno)));
+  auto cmsg = CMSG_FIRSTHDR(&msg);
+  ASSERT(cmsg != nullptr && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS &&
+             !(msg.msg_flags & MSG_CTRUNC),
+         "no fds received");
+  std::vector<int> fds((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+  std::memcpy(fds.data(), CMSG_DATA(cmsg), sizeof(int) * fds.size());
+  ASSERT(fds.size() == count, "received fds: {} != sent fds: {}", fds.size(), count);
+
+  std::vector<MmapManager> managers;
+  for (const auto& fd : fds) {
+    size_t length = get_fd_length(fd);
+    ASSERT(length > 0, std::format("received fd {} is empty", fd));
+    managers.push_back(MmapManager(std::make_shared<MmapManager::Impl>(std::format("fd:{}", fd), fd, length, options)));
+  }
+  return managers;
+}
+
+MmapManager MmapManager::slice(size_t offset, size_t length) const {
+  ASSERT(offset + length <= impl_->file_length_,
+         std::format("slice out of range, offset: {}, length: {}, file length: {}", offset, length,
+                     impl_->file_length_));
+  return MmapManager(std::make_shared<MmapManager::Impl>(impl_, offset, length));
+}
+
+size_t MmapManager::length() const noexcept { return impl_->file_length_; }
+
 IMmapReader* MmapManager::reader() const noexcept { return impl_->reader(); }
 IMmapWriter* MmapManager::writer() const noexcept { return impl_->writer(); }
 }  // namespace arrow_mmap
@@ -2,24 +2,57 @@
 #define ARROW_MMAP_MANAGER_HPP
 #pragma once
 
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "arrow_mmap/interface.hpp"
 #include "sys/mman.h"
 
 namespace arrow_mmap {
 
+/**
+ * @brief WindowOptions bounds the populated part of a mapping to the windows accessed most recently.
+ *
+ * The file is still reserved as one mapping, but it is populated window by window as `range` reaches them, and the
+ * page tables of the least recently used window are dropped once more than `cache` windows are populated. Dropped
+ * windows are remapped in place, so stale pointers into them are still valid and just fault the pages in again.
+ */
+struct WindowOptions {
+  // the byte size of a window, rounded up to whole pages, 0 populates the whole file at once
+  size_t size = 0;
+  // the number of recently used windows which stay populated, should be at least the number of cursors accessing the
+  // mapping concurrently, e.g. the reader, every writer and the threads of an aggregator
+  size_t cache = 4;
+};
+
+enum class MmapBackend {
+  // a file at the given path, on whatever filesystem the path is on
+  FILE,
+  // a POSIX shared memory object named after the path, which is never written back to a block device
+  SHM,
+  // an anonymous memfd, which other processes can only open by receiving its fd, see `MmapManager::send`
+  MEMFD,
+};
+
 struct MmapManagerOptions {
   int reader_flags = 0;
   int writer_flags = 0;
   int madvise = MADV_WILLNEED;
+  WindowOptions window = {};
+  MmapBackend backend = MmapBackend::FILE;
 };
 
 struct MmapManagerCreateOptions {
   int reader_flags = 0;
   int writer_flags = 0;
   int madvise = MADV_WILLNEED;
+  WindowOptions window = {};
+  MmapBackend backend = MmapBackend::FILE;
   std::byte fill_with = std::byte(0x00);
+  // leave the file sparse instead of filling it, blocks are then allocated by the first write to each page, so a full
+  // disk raises SIGBUS in the writer instead of failing `create`, requires `fill_with` to be 0
+  bool sparse = false;
 };
 
 class MmapManager {
@@ -28,14 +61,48 @@ class MmapManager {
   static MmapManager create(const std::string& file, size_t length, const MmapManagerCreateOptions& options = {});
   ~MmapManager();
 
+  /**
+   * @brief Check if `file` exists in `backend` and can be opened, a memfd never exists by name.
+   */
+  static bool exists(const std::string& file, const MmapBackend backend) noexcept;
+
+  /**
+   * @brief Remove `file` from `backend`, the data stays alive until every mapping of it is released.
+   */
+  static void remove(const std::string& file, const MmapBackend backend);
+
+  /**
+   * @brief Send the fds of `managers` over a connected unix socket, so another process can `receive` them.
+   *
+   * This is how memfd backed managers are shared, but any backend can be sent.
+   */
+  static void send(int socket, const std::vector<const MmapManager*>& managers);
+
+  /**
+   * @brief Receive the managers sent with `send`, in the same order.
+   */
+  static std::vector<MmapManager> receive(int socket, const MmapManagerOptions& options = {});
+
   // disable copy and assign
   MmapManager(const MmapManager&) = delete;
   MmapManager& operator=(const MmapManager&) = delete;
 
   // support move
-  MmapManager(MmapManager&& other) noexcept : impl_(other.impl_) { other.impl_ = nullptr; }
+  MmapManager(MmapManager&& other) noexcept = default;
+
+  /**
+   * @brief Get a manager of the byte range [offset, offset + length) of this file.
+   *
+   * The slice shares the mappings and the file descriptor of this manager instead of mapping the file again, and
+   * keeps them alive until the slice is released as well.
+   */
+  MmapManager slice(size_t offset, size_t length) const;
+
+  // the length of the file, or of the slice, without mapping it
+  size_t length() const noexcept;
 
-  // since we never unmap the file, so we don't need to use shared_ptr
+  // the file is unmapped and closed when the last manager sharing it is released, so the returned pointers must not
+  // outlive the manager
   IMmapReader* reader() const noexcept;
   IMmapWriter* writer() const noexcept;
 
@@ -43,9 +110,9 @@ class MmapManager {
   class Impl;
   friend class Impl;
 
-  MmapManager(Impl* impl) : impl_(impl) {}
+  MmapManager(std::shared_ptr<Impl> impl) : impl_(std::move(impl)) {}
 
-  Impl* impl_;
+  std::shared_ptr<Impl> impl_;
 };
 
 }  // namespace arrow_mmap
@@ -0,0 +1,136 @@
+#ifndef ARROW_MMAP_METRICS_HPP
+#define ARROW_MMAP_METRICS_HPP
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#ifdef ARROW_MMAP_METRICS_FAULTS
+#include <sys/resource.h>
+#endif
+
+#if defined(ARROW_MMAP_METRICS) && __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define ARROW_MMAP_PROBE2(name, a1, a2) DTRACE_PROBE2(arrow_mmap, name, a1, a2)
+#else
+#define ARROW_MMAP_PROBE2(name, a1, a2) \
+  do {                                  \
+  } while (0)
+#endif
+
+namespace arrow_mmap {
+
+/**
+ * @brief The counters of one ArrowWriter, all zero unless built with `ARROW_MMAP_METRICS`.
+ *
+ * Faults are only counted when built with `ARROW_MMAP_METRICS_FAULTS`, which costs two `getrusage` calls per batch.
+ */
+struct alignas(64) WriterMetrics {
+  // batches passed to `write`
+  uint64_t batches = 0;
+  // bytes copied into the data file
+  uint64_t bytes = 0;
+  // time spent copying the batches into the data file
+  uint64_t copy_ns = 0;
+  // time `write` stalled publishing, in the flush of `FlushPolicy::SYNC` or handing over to the flusher
+  uint64_t publish_ns = 0;
+  // time spent blocked in `flush`
+  uint64_t flush_ns = 0;
+  // page faults taken by the writer thread while copying
+  uint64_t minor_faults = 0;
+  uint64_t major_faults = 0;
+};
+
+/**
+ * @brief The counters of one ArrowReader, all zero unless built with `ARROW_MMAP_METRICS`.
+ */
+struct alignas(64) ReaderMetrics {
+  // batches returned by `read`
+  uint64_t batches = 0;
+  // calls of `read` which returned false because a batch is not fully written yet
+  uint64_t not_ready = 0;
+  // time spent in `read`, including the calls which returned false
+  uint64_t read_ns = 0;
+};
+
+struct ArrowMetrics {
+  // indexed by writer id, writers which were never created are all zero
+  std::vector<WriterMetrics> writers;
+  ReaderMetrics reader;
+};
+
+namespace metrics {
+
+#ifdef ARROW_MMAP_METRICS
+inline constexpr bool ENABLED = true;
+#else
+inline constexpr bool ENABLED = false;
+#endif
+
+/**
+ * Add to a counter which has a single writing thread.
+ *
+ * A relaxed load and store instead of a locked add, other threads only ever take snapshots with `load`.
+ */
+inline void add(uint64_t& counter, const uint64_t value) noexcept {
+  if constexpr (ENABLED) {
+    std::atomic_ref ref(counter);
+    ref.store(ref.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+  }
+}
+
+inline uint64_t load(const uint64_t& counter) noexcept {
+  return std::atomic_ref(const_cast<uint64_t&>(counter)).load(std::memory_order_relaxed);
+}
+
+// monotonic nanoseconds, always 0 when metrics are disabled so the clock is never read
+inline uint64_t now() noexcept {
+  if constexpr (ENABLED) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+  return 0;
+}
+
+struct Faults {
+  uint64_t minor = 0;
+  uint64_t major = 0;
+};
+
+// the faults taken by the calling thread so far
+inline Faults faults() noexcept {
+#ifdef ARROW_MMAP_METRICS_FAULTS
+  rusage usage;
+  getrusage(RUSAGE_THREAD, &usage);
+  return {static_cast<uint64_t>(usage.ru_minflt), static_cast<uint64_t>(usage.ru_majflt)};
+#else
+  return {};
+#endif
+}
+
+inline WriterMetrics snapshot(const WriterMetrics& metrics) noexcept {
+  WriterMetrics ret;
+  ret.batches = load(metrics.batches);
+  ret.bytes = load(metrics.bytes);
+  ret.copy_ns = load(metrics.copy_ns);
+  ret.publish_ns = load(metrics.publish_ns);
+  ret.flush_ns = load(metrics.flush_ns);
+  ret.minor_faults = load(metrics.minor_faults);
+  ret.major_faults = load(metrics.major_faults);
+  return ret;
+}
+
+inline ReaderMetrics snapshot(const ReaderMetrics& metrics) noexcept {
+  ReaderMetrics ret;
+  ret.batches = load(metrics.batches);
+  ret.not_ready = load(metrics.not_ready);
+  ret.read_ns = load(metrics.read_ns);
+  return ret;
+}
+
+}  // namespace metrics
+}  // namespace arrow_mmap
+
+#endif  // ARROW_MMAP_METRICS_HPP
@@ -0,0 +1,131 @@
+#include "arrow_mmap/thread_pool.hpp"
+
+#include <libassert/assert.hpp>
+
+#include <pthread.h>
+#include <sched.h>
+
+namespace arrow_mmap {
+
+static inline uint64_t pack(uint32_t begin, uint32_t end) { return (static_cast<uint64_t>(end) << 32) | begin; }
+static inline uint32_t range_begin(uint64_t value) { return static_cast<uint32_t>(value); }
+static inline uint32_t range_end(uint64_t value) { return static_cast<uint32_t>(value >> 32); }
+
+ThreadPool::ThreadPool(size_t threads, const std::vector<int>& cpus)
+    : ranges_(threads > 0 ? threads : std::max<size_t>(1, std::thread::hardware_concurrency())) {
+  for (size_t worker = 1; worker < ranges_.size(); worker++) {
+    threads_.emplace_back([this, worker]() { loop(worker); });
+    if (cpus.empty()) continue;
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(cpus[(worker - 1) % cpus.size()], &cpu_set);
+    auto ret = pthread_setaffinity_np(threads_.back().native_handle(), sizeof(cpu_set), &cpu_set);
+    ASSERT(ret == 0, "pthread_setaffinity_np failed, cpu: {}, error: {}", cpus[(worker - 1) % cpus.size()], ret);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard lock(mutex_);
+    stop_ = true;
+  }
+  start_cv_.notify_all();
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+}
+
+void ThreadPool::parallel_for(size_t tasks, const std::function<void(size_t task, size_t worker)>& fn) {
+  ASSERT(tasks <= UINT32_MAX, "too many tasks, tasks: {}", tasks);
+  if (tasks == 0) return;
+
+  // only one parallel_for can use the workers at a time
+  std::lock_guard run_lock(run_mutex_);
+
+  auto workers = ranges_.size();
+  for (size_t worker = 0; worker < workers; worker++) {
+    auto begin = static_cast<uint32_t>(tasks * worker / workers);
+    auto end = static_cast<uint32_t>(tasks * (worker + 1) / workers);
+    ranges_[worker].value.store(pack(begin, end), std::memory_order_relaxed);
+  }
+
+  {
+    std::lock_guard lock(mutex_);
+    fn_ = &fn;
+    running_ = threads_.size();
+    generation_++;
+  }
+  start_cv_.notify_all();
+
+  work(0);
+
+  std::unique_lock lock(mutex_);
+  done_cv_.wait(lock, [this]() { return running_ == 0; });
+  fn_ = nullptr;
+}
+
+void ThreadPool::work(size_t worker) {
+  size_t task;
+  while (pop(worker, task)) (*fn_)(task, worker);
+
+  auto workers = ranges_.size();
+  for (size_t i = 1; i < workers; i++) {
+    auto victim = (worker + i) % workers;
+    while (steal(worker, victim)) {
+      while (pop(worker, task)) (*fn_)(task, worker);
+    }
+  }
+}
+
+bool ThreadPool::pop(size_t worker, size_t& task) {
+  auto& range = ranges_[worker].value;
+  auto value = range.load(std::memory_order_acquire);
+  while (true) {
+    auto begin = range_begin(value);
+    auto end = range_end(value);
+    if (begin >= end) return false;
+    if (range.compare_exchange_weak(value, pack(begin + 1, end), std::memory_order_acq_rel)) {
+      task = begin;
+      return true;
+    }
+  }
+}
+
+bool ThreadPool::steal(size_t thief, size_t victim) {
+  auto& range = ranges_[victim].value;
+  auto value = range.load(std::memory_order_acquire);
+  while (true) {
+    auto begin = range_begin(value);
+    auto end = range_end(value);
+    if (begin >= end) return false;
+    // take the back half, rounding up so a single remaining task can be stolen as well
+    auto mid = begin + (end - begin) / 2;
+    if (range.compare_exchange_weak(value, pack(begin, mid), std::memory_order_acq_rel)) {
+      // the thief's own range is empty here, so nobody else can take from it until this store
+      ranges_[thief].value.store(pack(mid, end), std::memory_order_release);
+      return true;
+    }
+  }
+}
+
+void ThreadPool::loop(size_t worker) {
+  uint64_t seen = 0;
+  while (true) {
+    {
+      std::unique_lock lock(mutex_);
+      start_cv_.wait(lock, [&]() { return stop_ || generation_ != seen; });
+      if (stop_) return;
+      seen = generation_;
+    }
+
+    work(worker);
+
+    {
+      std::lock_guard lock(mutex_);
+      running_--;
+    }
+    done_cv_.notify_one();
+  }
+}
+
+}  // namespace arrow_mmap
@@ -0,0 +1,72 @@
+#ifndef ARROW_MMAP_THREAD_POOL_HPP
+#define ARROW_MMAP_THREAD_POOL_HPP
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace arrow_mmap {
+
+/**
+ * @brief A fixed-size work-stealing thread pool.
+ *
+ * `parallel_for` splits the task range evenly across workers. Each worker consumes its own range from the front, and
+ * once it runs dry steals the back half of another worker's range, so uneven tasks still keep every core busy.
+ */
+class ThreadPool {
+ public:
+  /**
+   * @param threads The number of workers including the calling thread, 0 means `std::thread::hardware_concurrency()`.
+   * @param cpus Pin the background workers round-robin to these cpus, empty leaves them unpinned. The calling thread
+   * is never pinned.
+   */
+  explicit ThreadPool(size_t threads = 0, const std::vector<int>& cpus = {});
+  ~ThreadPool();
+
+  // disable copy and assign
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  size_t size() const noexcept { return ranges_.size(); }
+
+  /**
+   * @brief Run `fn(task, worker)` for every task in [0, tasks), blocks until all tasks are done.
+   *
+   * The calling thread participates as worker 0. `worker` is always less than `size()`, so callers can keep
+   * per-worker state without synchronization.
+   */
+  void parallel_for(size_t tasks, const std::function<void(size_t task, size_t worker)>& fn);
+
+ private:
+  // [begin, end) packed into one word, so owner pops and thief steals are a single CAS
+  struct alignas(64) Range {
+    std::atomic<uint64_t> value{0};
+  };
+
+  void work(size_t worker);
+  bool pop(size_t worker, size_t& task);
+  bool steal(size_t thief, size_t victim);
+  void loop(size_t worker);
+
+  std::vector<Range> ranges_;
+  std::vector<std::thread> threads_;
+
+  std::mutex run_mutex_;
+  std::mutex mutex_;
+  std::condition_variable start_cv_;
+  std::condition_variable done_cv_;
+  uint64_t generation_ = 0;
+  size_t running_ = 0;
+  bool stop_ = false;
+  const std::function<void(size_t, size_t)>* fn_ = nullptr;
+};
+
+}  // namespace arrow_mmap
+
+#endif  // ARROW_MMAP_THREAD_POOL_HPP